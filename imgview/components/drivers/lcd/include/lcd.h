@@ -61,6 +61,13 @@
 #define COLOR_FUCHSIA     0xF81F
 #define COLOR_ESP_BKGD    0xD185
 
+#define LCD_TRANS_NUM         12     // pooled transactions, also the device queue size
+#define LCD_ASYNC_TRANS_MAX   4092   // bytes per queued transaction, within the default max_transfer_sz
+#define LCD_FILL_PIXELS       (LCD_ASYNC_TRANS_MAX / 2)  // solid color line queued by fills
+#define LCD_FRAME_TRANS_MAX   (LCD_TFTWIDTH * LCD_TFTHEIGHT * 2)  // max_transfer_sz of a bus set up by lcd_init
+#define LCD_DIRTY_MAX         8      // dirty rectangles tracked in framebuffer mode
+#define LCD_DIRTY_SLACK       256    // clean pixels worth flushing along to save a window
+
 #define MAKEWORD(b1, b2, b3, b4) (uint32_t(b1) | ((b2) << 8) | ((b3) << 16) | ((b4) << 24))
 
 /**
@@ -96,6 +103,10 @@ typedef struct {
     uint8_t dc_level;
 } lcd_dc_t;
 
+typedef struct {
+    int16_t x0, y0, x1, y1;     /*!<inclusive corners*/
+} lcd_rect_t;
+
 #ifdef __cplusplus
 #include "Adafruit_GFX.h"
 
@@ -112,6 +123,32 @@ private:
     SemaphoreHandle_t spi_mux;
     gpio_num_t cmd_io = GPIO_NUM_MAX;
     lcd_dc_t dc;
+    spi_transaction_t trans[LCD_TRANS_NUM];  // queued transaction pool, reused in order
+    lcd_dc_t trans_dc[LCD_TRANS_NUM];        // D/C level of each pooled transaction
+    int trans_head;                          // next descriptor to queue
+    int trans_pending;                       // queued and not reaped yet
+    uint32_t trans_seq;                      // transactions queued so far
+    uint16_t *dma_buf[2];                    // DMA capable scratch pixels, kept for the driver's lifetime
+    uint32_t dma_done[2];                    // transaction that last reads each scratch buffer
+    int dma_chunk;                           // pixels per scratch buffer
+    int dma_next;                            // scratch buffer to use next
+    uint32_t dma_allocs_saved;               // draw calls served without a buffer allocation
+    uint16_t *fill_buf;                      // DMA capable line of fill_color, queued repeatedly by fills
+    uint16_t fill_color;                     // byte swapped color of the fill line
+    int fill_len;                            // pixels of the fill line holding fill_color
+    uint32_t fill_done;                      // transaction that last reads the fill line
+    uint8_t madctl;         // MADCTL of the current rotation
+    uint8_t madctl_sent;    // MADCTL last written to the panel
+    uint32_t caset_sent;    // CASET parameters last written to the panel
+    uint32_t paset_sent;    // PASET parameters last written to the panel
+    uint16_t *framebuffer;                   // frame in wire byte order, NULL when drawing to the panel
+    uint32_t fb_done;                        // transaction that last reads the framebuffer
+    int fb_trans_max;                        // bytes per transaction the bus takes
+    int fb_x0, fb_y0, fb_x1, fb_y1;          // window pixels are streamed into
+    int fb_cx, fb_cy;                        // next pixel of the window
+    bool fb_bottom_up;                       // the window fills from its bottom row up
+    lcd_rect_t dirty[LCD_DIRTY_MAX];         // regions drawn since the last flush
+    int dirty_num;
 
     /*Below are the functions which actually send data, defined in spi_ili.c*/
     void transmitCmdData(uint8_t cmd, const uint8_t data, uint8_t numDataByte);
@@ -120,8 +157,20 @@ private:
     inline void transmitData(uint16_t data, int32_t repeats);
     inline void transmitData(uint8_t* data, int length);
     inline void transmitCmd(uint8_t cmd);
+    /*Queued path: descriptors come from the pool and are reaped lazily, oldest first*/
+    int nextTrans();
+    void reapTrans();
+    void waitTrans(uint32_t seq);
+    void queueCmd(uint8_t cmd);
+    void queueData(const void *data, int len);
+    int dmaBuf();
+    void sendDmaBuf(int k, int points);
     void _fastSendBuf(const uint16_t* buf, int point_num, bool swap = true);
     void _fastSendRep(uint16_t val, int rep_num);
+    void sendAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, bool bottom_up);
+    /*Framebuffer mode: buf, or val repeated if it is NULL, into the window*/
+    void fbWrite(const uint16_t *buf, uint16_t val, int n, bool swap);
+    void markDirty(int x0, int y0, int x1, int y1);
     /**
      * @brief Avoid using it, Internal use for main class drawChar API
      */
@@ -130,6 +179,34 @@ public:
     lcd_id_t id;
     CMyLcd(lcd_conf_t* lcd_conf, int height = LCD_TFTHEIGHT, int width = LCD_TFTWIDTH, bool dma_en = true, int dma_word_size = 1024, int dma_chan = 1);
     virtual ~CMyLcd();
+    /**
+     * @brief Number of draw calls that reused the driver's DMA buffers instead of allocating one
+     */
+    uint32_t allocsAvoided() const { return dma_allocs_saved; }
+
+    /**
+     * @brief Draw into a RAM framebuffer instead of the panel. Every drawing call, including
+     *        windows filled with fillDataFast/fillDataAsync, only changes the frame and marks
+     *        its area dirty; nothing shows until flush(). Nearby dirty areas are merged, so
+     *        a flush may also push a few clean pixels around them.
+     *        Enabling clears the screen: the frame starts black and wholly dirty. setRotation()
+     *        clears the frame without marking anything, the whole screen must be redrawn
+     *        before the next flush().
+     * @param enable allocate the frame (DMA capable, width * height * 2 bytes), or flush and free it
+     * @return
+     *     - ESP_ERR_INVALID_STATE without DMA
+     *     - ESP_ERR_NO_MEM if the frame can't be allocated
+     *     - ESP_OK on success
+     */
+    esp_err_t setFramebuffer(bool enable);
+
+    /**
+     * @brief Push the dirty areas of the framebuffer to the panel, each with one window set and
+     *        its pixels queued back to back through the scratch buffers. Areas that widened to
+     *        whole rows add at most LCD_DIRTY_SLACK pixels are sent as rows straight from the
+     *        frame. Returns while DMA is running; drawing waits for it.
+     */
+    void flush();
     /**
      * @brief init spi bus and lcd screen
      * @param lcd_conf LCD parameters
@@ -166,6 +243,20 @@ public:
     void drawBitmap(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h);
     void fillDataFast(const uint16_t *pData, uint16_t size, bool swap = true);
 
+    /**
+     * @brief Queue pixels into the current address window and return while DMA is still sending them
+     * @param pData DMA capable pixel buffer, owned by the driver until fillWait() returns
+     * @param size number of pixels
+     * @param swap byte swap each pixel (done in place in pData)
+     */
+    void fillDataAsync(const uint16_t *pData, uint16_t size, bool swap = true);
+
+    /**
+     * @brief Wait until everything queued has been sent: pixels from fillDataAsync(), and the
+     *        windows and pixels drawing calls leave in flight when they return
+     */
+    void fillWait();
+
     /**
      * @brief Load bitmap data from flash partition and fill the pixels on LCD screen
      * @param x Start position
@@ -174,7 +265,7 @@ public:
      * @param h height of image in bmp array
      * @param data_partition Flash storage that contains the bitmap data array.
      * @param data_offset bitmap array begin offset
-     * @param malloc_pixal_size internal buffer size that driver would allocate.
+     * @param malloc_pixal_size pixels read per chunk, at most the driver's DMA buffer size.
      * @param swap_bytes_en Whether to enable byte swap for each pixel word
      *
      * @return
@@ -215,6 +306,8 @@ public:
 
     /**
      * @brief Draw a filled rectangle
+     *        The color is prepared once in a DMA line that is queued back to back, a full
+     *        screen takes about ten transfers. Refilling with the same color reuses the line.
      * @param x & y co-ordinates of start point
      * @param w & h of rectangle to be displayed
      * @param object color
@@ -230,8 +323,15 @@ public:
     /*Yet to figure out what this does*/
     void invertDisplay(bool i);
 
-    /*Not useful for user, sets the Region of Interest window*/
-    void setAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1);
+    /**
+     * @brief Not useful for user, sets the Region of Interest window
+     * @param bottom_up pixels fill the window from its bottom row upwards (BMP row order).
+     *        MADCTL is only rewritten when the row order changes from the previous window,
+     *        CASET and PASET only when their range does: consecutive characters on a line
+     *        cost CASET and RAMWR. The commands are queued, pixels sent afterwards follow
+     *        them on the bus.
+     */
+    void setAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, bool bottom_up = false);
 
     /**
      * @brief Scroll on Y-axis
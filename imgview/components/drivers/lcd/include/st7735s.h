@@ -41,6 +41,21 @@ void lcd_cmd(spi_device_handle_t spi, const uint8_t cmd, lcd_dc_t *dc);
  which waits until the transfer is complete */
 void lcd_data(spi_device_handle_t spi, const uint8_t *data, int len, lcd_dc_t *dc);
 
+/*Set up num transaction descriptors for lcd_cmd_queue/lcd_data_queue. Each one gets its own
+ D/C state in dc[], so queued commands and data can follow each other on the bus. */
+void lcd_trans_init(spi_transaction_t *t, lcd_dc_t *dc, int num, uint8_t dc_io);
+
+/*Queue a command to the LCD without waiting, on a descriptor from lcd_trans_init. */
+void lcd_cmd_queue(spi_device_handle_t spi, spi_transaction_t *t, const uint8_t cmd);
+
+/*Queue data to the LCD without waiting, on a descriptor from lcd_trans_init. Up to 4 bytes
+ are copied into the descriptor; longer data must be DMA capable and, like the descriptor,
+ stay untouched until the result is fetched with lcd_wait_queued. */
+void lcd_data_queue(spi_device_handle_t spi, spi_transaction_t *t, const uint8_t *data, int len);
+
+/*Wait for num queued transactions to complete, oldest first */
+void lcd_wait_queued(spi_device_handle_t spi, int num);
+
 /** @brief Read LCD IDs using SPI, not working yet
  * The 1st parameter is dummy data.
  * The 2nd parameter (ID1 [7:0]): LCD module's manufacturer ID.
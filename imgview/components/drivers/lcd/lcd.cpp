@@ -36,6 +36,7 @@ POSSIBILITY OF SUCH DAMAGE.
  */
 
 
+#include <sys/param.h>
 #include "Adafruit_GFX.h"
 #include "lcd.h"
 #include "st7735s.h"
@@ -43,6 +44,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "glcdfont.h"
 
 #include "esp_partition.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
 
@@ -71,11 +73,49 @@ CMyLcd::CMyLcd(lcd_conf_t* lcd_conf, int height, int width, bool dma_en, int dma
     dma_buf_size = dma_word_size;
     spi_mux = xSemaphoreCreateRecursiveMutex();
     m_dma_chan = dma_chan;
+    trans_head = 0;
+    trans_pending = 0;
+    trans_seq = 0;
+    // Both scratch buffers fit one queued transaction.
+    dma_chunk = MIN(dma_buf_size, LCD_ASYNC_TRANS_MAX / 2);
+    dma_next = 0;
+    dma_allocs_saved = 0;
+    for (int i = 0; i < 2; i++) {
+        dma_buf[i] = (uint16_t*) heap_caps_malloc(dma_chunk * sizeof(uint16_t), MALLOC_CAP_DMA);
+        dma_done[i] = 0;
+    }
+    fill_buf = (uint16_t*) heap_caps_malloc(LCD_FILL_PIXELS * sizeof(uint16_t), MALLOC_CAP_DMA);
+    fill_color = 0;
+    fill_len = 0;
+    fill_done = 0;
+    if (dma_buf[0] == NULL || dma_buf[1] == NULL || fill_buf == NULL) {
+        ESP_LOGE(TAG, "Cannot allocate DMA buffers, pixels are sent one by one");
+        heap_caps_free(dma_buf[0]);
+        heap_caps_free(dma_buf[1]);
+        heap_caps_free(fill_buf);
+        dma_buf[0] = dma_buf[1] = NULL;
+        fill_buf = NULL;
+        dma_mode = false;
+    }
+    framebuffer = NULL;
+    fb_done = 0;
+    // A bus set up elsewhere may only take the default transfer size.
+    fb_trans_max = lcd_conf->init_spi_bus ? LCD_FRAME_TRANS_MAX : LCD_ASYNC_TRANS_MAX;
+    dirty_num = 0;
     setSpiBus(lcd_conf);
+    lcd_trans_init(trans, trans_dc, LCD_TRANS_NUM, cmd_io);
+    madctl = madctl_sent = MADCTL_MX | MADCTL_MY | MADCTL_RGB;  // as left by lcd_init
+    caset_sent = MAKEWORD(0, 0, 0, LCD_TFTWIDTH - 1);
+    paset_sent = MAKEWORD(0, 0, 0, LCD_TFTHEIGHT - 1);
 }
 
 CMyLcd::~CMyLcd()
 {
+    fillWait();
+    heap_caps_free(dma_buf[0]);
+    heap_caps_free(dma_buf[1]);
+    heap_caps_free(fill_buf);
+    heap_caps_free(framebuffer);
     spi_bus_remove_device(spi_wr);
     vSemaphoreDelete(spi_mux);
 }
@@ -90,24 +130,308 @@ void CMyLcd::setSpiBus(lcd_conf_t *lcd_conf)
     id.lcd_id = (id.id >> (8 * 3)) & 0xff;
 }
 
-void CMyLcd::setAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+void CMyLcd::setAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, bool bottom_up)
+{
+    if (framebuffer == NULL) {
+        sendAddrWindow(x0, y0, x1, y1, bottom_up);
+        return;
+    }
+    // Drawing calls only clip right and bottom, a window may start past the left or top edge
+    // and come in wrapped: take it as signed. fbWrite() drops what is off the screen.
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fb_x0 = (int16_t) x0;
+    fb_x1 = (int16_t) x1;
+    fb_y0 = (int16_t) y0;
+    fb_y1 = (int16_t) y1;
+    fb_bottom_up = bottom_up;
+    fb_cx = fb_x0;
+    fb_cy = bottom_up ? fb_y1 : fb_y0;
+    markDirty(fb_x0, fb_y0, fb_x1, fb_y1);
+    xSemaphoreGiveRecursive(spi_mux);
+}
+
+void CMyLcd::sendAddrWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1, bool bottom_up)
+{
+    uint8_t m = madctl;
+    if (bottom_up) {
+        // Mirror the logical y axis (MX once X and Y are exchanged) and the window with it,
+        // the panel then fills the window from its last row up.
+        m ^= (madctl & MADCTL_MV) ? MADCTL_MX : MADCTL_MY;
+        uint16_t y = y0;
+        y0 = _height - 1 - y1;
+        y1 = _height - 1 - y;
+    }
+    uint32_t caset = MAKEWORD(x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF);
+    uint32_t paset = MAKEWORD(y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF);
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    if (m != madctl_sent) {
+        queueCmd(LCD_MADCTL);
+        queueData(&m, 1);
+        madctl_sent = m;
+    }
+    // The panel keeps its column and page range, RAMWR alone restarts the window. A command
+    // and its parameters stay two transactions: D/C is set per transaction by the pre-callback.
+    if (caset != caset_sent) {
+        queueCmd(LCD_CASET);
+        queueData(&caset, 4);
+        caset_sent = caset;
+    }
+    if (paset != paset_sent) {
+        queueCmd(LCD_PASET);
+        queueData(&paset, 4);
+        paset_sent = paset;
+    }
+    queueCmd(LCD_RAMWR); // write to RAM
+    xSemaphoreGiveRecursive(spi_mux);
+}
+
+void CMyLcd::fbWrite(const uint16_t *buf, uint16_t val, int n, bool swap)
+{
+    // Like the panel: rows of the window in order, wrapping to its first one when it is full.
+    // Pixels off the screen are dropped.
+    if (fb_x1 < fb_x0 || fb_y1 < fb_y0) {
+        return;
+    }
+    waitTrans(fb_done);
+    while (n > 0) {
+        if (fb_cx > fb_x1) {
+            fb_cx = fb_x0;
+            fb_cy += fb_bottom_up ? -1 : 1;
+        }
+        if (fb_cy < fb_y0 || fb_cy > fb_y1) {
+            fb_cy = fb_bottom_up ? fb_y1 : fb_y0;
+        }
+        int k = MIN(n, fb_x1 - fb_cx + 1);
+        // The columns left of the screen are skipped in buf too.
+        int skip = MAX(0, -fb_cx);
+        int len = MIN(k, _width - fb_cx) - skip;
+        if (fb_cy >= 0 && fb_cy < _height && len > 0) {
+            uint16_t *dst = framebuffer + fb_cy * _width + fb_cx + skip;
+            if (buf == NULL) {
+                for (int i = 0; i < len; i++) {
+                    dst[i] = val;
+                }
+            } else if (swap) {
+                for (int i = 0; i < len; i++) {
+                    dst[i] = SWAPBYTES(buf[skip + i]);
+                }
+            } else {
+                memcpy(dst, buf + skip, len * sizeof(uint16_t));
+            }
+        }
+        if (buf != NULL) {
+            buf += k;
+        }
+        fb_cx += k;
+        n -= k;
+    }
+}
+
+static inline int rect_area(const lcd_rect_t *r)
+{
+    return (r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+}
+
+static inline lcd_rect_t rect_union(const lcd_rect_t *a, const lcd_rect_t *b)
+{
+    lcd_rect_t u = {MIN(a->x0, b->x0), MIN(a->y0, b->y0), MAX(a->x1, b->x1), MAX(a->y1, b->y1)};
+    return u;
+}
+
+void CMyLcd::markDirty(int x0, int y0, int x1, int y1)
 {
+    lcd_rect_t r = {(int16_t) MAX(x0, 0), (int16_t) MAX(y0, 0),
+                    (int16_t) MIN(x1, _width - 1), (int16_t) MIN(y1, _height - 1)};
+    if (r.x0 > r.x1 || r.y0 > r.y1) {
+        return;
+    }
+    for (int i = 0; i < dirty_num; i++) {
+        if (r.x0 >= dirty[i].x0 && r.x1 <= dirty[i].x1 && r.y0 >= dirty[i].y0 && r.y1 <= dirty[i].y1) {
+            return;
+        }
+    }
+    // Take in every rectangle whose union adds fewer clean pixels than a window costs, and
+    // start over since the grown one may reach others now.
+    for (int i = 0; i < dirty_num;) {
+        lcd_rect_t u = rect_union(&r, &dirty[i]);
+        if (rect_area(&u) - rect_area(&r) - rect_area(&dirty[i]) <= LCD_DIRTY_SLACK) {
+            r = u;
+            dirty[i] = dirty[--dirty_num];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    if (dirty_num < LCD_DIRTY_MAX) {
+        dirty[dirty_num++] = r;
+        return;
+    }
+    // No room left: grow the rectangle that grows least.
+    int best = 0, best_cost = 0;
+    for (int i = 0; i < dirty_num; i++) {
+        lcd_rect_t u = rect_union(&r, &dirty[i]);
+        int cost = rect_area(&u) - rect_area(&dirty[i]);
+        if (i == 0 || cost < best_cost) {
+            best = i;
+            best_cost = cost;
+        }
+    }
+    dirty[best] = rect_union(&r, &dirty[best]);
+}
+
+esp_err_t CMyLcd::setFramebuffer(bool enable)
+{
+    if (enable == (framebuffer != NULL)) {
+        return ESP_OK;
+    }
+    if (enable && !dma_mode) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    if (enable) {
+        framebuffer = (uint16_t*) heap_caps_calloc(m_width * m_height, sizeof(uint16_t), MALLOC_CAP_DMA);
+        if (framebuffer == NULL) {
+            ret = ESP_ERR_NO_MEM;
+        } else {
+            // The panel doesn't hold what the frame does, the first flush clears it.
+            fb_done = 0;
+            dirty_num = 0;
+            markDirty(0, 0, _width - 1, _height - 1);
+            fb_x0 = fb_y0 = fb_x1 = fb_y1 = fb_cx = fb_cy = 0;
+            fb_bottom_up = false;
+        }
+    } else {
+        flush();
+        fillWait();
+        heap_caps_free(framebuffer);
+        framebuffer = NULL;
+    }
+    xSemaphoreGiveRecursive(spi_mux);
+    return ret;
+}
+
+void CMyLcd::flush()
+{
+    if (framebuffer == NULL) {
+        return;
+    }
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
-    transmitCmdData(LCD_CASET, MAKEWORD(x0 >> 8, x0 & 0xFF, x1 >> 8, x1 & 0xFF));
-    transmitCmdData(LCD_PASET, MAKEWORD(y0 >> 8, y0 & 0xFF, y1 >> 8, y1 & 0xFF));
-    transmitCmd(LCD_RAMWR); // write to RAM
+    for (int i = 0; i < dirty_num; i++) {
+        lcd_rect_t *r = &dirty[i];
+        int w = r->x1 - r->x0 + 1;
+        int h = r->y1 - r->y0 + 1;
+        if ((_width - w) * h > LCD_DIRTY_SLACK) {
+            // Gather the rectangle into the scratch buffers, one piece each, queued back to back.
+            sendAddrWindow(r->x0, r->y0, r->x1, r->y1, false);
+            int x = r->x0, y = r->y0;
+            int point_num = w * h;
+            while (point_num > 0) {
+                int n = MIN(point_num, dma_chunk);
+                int k = dmaBuf();
+                for (int j = 0; j < n;) {
+                    int len = MIN(n - j, r->x1 - x + 1);
+                    memcpy(dma_buf[k] + j, framebuffer + y * _width + x, len * sizeof(uint16_t));
+                    j += len;
+                    x += len;
+                    if (x > r->x1) {
+                        x = r->x0;
+                        y++;
+                    }
+                }
+                queueData(dma_buf[k], n * sizeof(uint16_t));
+                dma_done[k] = trans_seq;
+                point_num -= n;
+            }
+        } else {
+            // Widened to whole rows, which are contiguous in the frame, it goes out as it is.
+            sendAddrWindow(0, r->y0, _width - 1, r->y1, false);
+            const uint8_t *data = (const uint8_t *) (framebuffer + r->y0 * _width);
+            int bytes = h * _width * sizeof(uint16_t);
+            while (bytes > 0) {
+                int len = bytes > fb_trans_max ? fb_trans_max : bytes;
+                queueData(data, len);
+                data += len;
+                bytes -= len;
+            }
+            fb_done = trans_seq;
+        }
+    }
+    dirty_num = 0;
     xSemaphoreGiveRecursive(spi_mux);
 }
 
+int CMyLcd::nextTrans()
+{
+    if (trans_pending == LCD_TRANS_NUM) {
+        // Every descriptor is in flight, reuse the oldest one.
+        reapTrans();
+    }
+    int slot = trans_head;
+    trans_head = (trans_head + 1) % LCD_TRANS_NUM;
+    trans_pending++;
+    trans_seq++;
+    return slot;
+}
+
+void CMyLcd::reapTrans()
+{
+    lcd_wait_queued(spi_wr, 1);
+    trans_pending--;
+}
+
+void CMyLcd::waitTrans(uint32_t seq)
+{
+    // Transactions complete in order: seq is done once fewer than trans_seq - seq are left.
+    while (trans_pending > 0 && trans_seq - trans_pending < seq) {
+        reapTrans();
+    }
+}
+
+void CMyLcd::queueCmd(uint8_t cmd)
+{
+    lcd_cmd_queue(spi_wr, &trans[nextTrans()], cmd);
+}
+
+void CMyLcd::queueData(const void *data, int len)
+{
+    lcd_data_queue(spi_wr, &trans[nextTrans()], (const uint8_t *) data, len);
+}
+
+int CMyLcd::dmaBuf()
+{
+    // The two buffers alternate: filling one overlaps the transfer of the other.
+    int k = dma_next;
+    dma_next ^= 1;
+    waitTrans(dma_done[k]);
+    return k;
+}
+
+void CMyLcd::sendDmaBuf(int k, int points)
+{
+    if (framebuffer != NULL) {
+        fbWrite(dma_buf[k], 0, points, false);
+        return;
+    }
+    if (!dma_mode) {
+        transmitData((uint8_t*) dma_buf[k], points * sizeof(uint16_t));
+        return;
+    }
+    queueData(dma_buf[k], points * sizeof(uint16_t));
+    dma_done[k] = trans_seq;
+}
+
 inline void CMyLcd::transmitData(uint16_t data)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_data(spi_wr, (uint8_t *)&data, 2, &dc);
     xSemaphoreGiveRecursive(spi_mux);
 }
 inline void CMyLcd::transmitCmdData(uint8_t cmd, uint32_t data)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_cmd(spi_wr, cmd, &dc);
     lcd_data(spi_wr, (uint8_t *)&data, 4, &dc);
     xSemaphoreGiveRecursive(spi_mux);
@@ -115,18 +439,21 @@ inline void CMyLcd::transmitCmdData(uint8_t cmd, uint32_t data)
 inline void CMyLcd::transmitData(uint16_t data, int32_t repeats)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_send_uint16_r(spi_wr, data, repeats, &dc);
     xSemaphoreGiveRecursive(spi_mux);
 }
 inline void CMyLcd::transmitData(uint8_t* data, int length)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_data(spi_wr, (uint8_t *)data, length, &dc);
     xSemaphoreGiveRecursive(spi_mux);
 }
 inline void CMyLcd::transmitCmd(uint8_t cmd)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_cmd(spi_wr, cmd, &dc);
     xSemaphoreGiveRecursive(spi_mux);
 }
@@ -134,6 +461,7 @@ inline void CMyLcd::transmitCmd(uint8_t cmd)
 void CMyLcd::transmitCmdData(uint8_t cmd, const uint8_t data, uint8_t numDataByte)
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     lcd_cmd(spi_wr, (const uint8_t) cmd, &dc);
     lcd_data(spi_wr, &data, 1, &dc);
     xSemaphoreGiveRecursive(spi_mux);
@@ -142,6 +470,7 @@ void CMyLcd::transmitCmdData(uint8_t cmd, const uint8_t data, uint8_t numDataByt
 uint32_t CMyLcd::getLcdId()
 {
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    fillWait();
     uint32_t id = lcd_get_id(spi_wr, &dc);
     xSemaphoreGiveRecursive(spi_mux);
     return id;
@@ -152,58 +481,81 @@ void CMyLcd::drawPixel(int16_t x, int16_t y, uint16_t color)
     if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height)) {
         return;
     }
+    uint16_t data = SWAPBYTES(color);
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    if (framebuffer != NULL) {
+        waitTrans(fb_done);
+        framebuffer[y * _width + x] = data;
+        markDirty(x, y, x, y);
+        xSemaphoreGiveRecursive(spi_mux);
+        return;
+    }
     setAddrWindow(x, y, x + 1, y + 1);
-    transmitData(SWAPBYTES(color));
+    queueData(&data, 2);
     xSemaphoreGiveRecursive(spi_mux);
 }
 
 void CMyLcd::_fastSendBuf(const uint16_t* buf, int point_num, bool swap)
 {
-    if ((point_num * sizeof(uint16_t)) <= (16 * sizeof(uint32_t))) {
-        transmitData((uint8_t*) buf, sizeof(uint16_t) * point_num);
-    } else {
-        int gap_point = dma_buf_size;
-        uint16_t* data_buf = (uint16_t*) malloc(gap_point * sizeof(uint16_t));
-        int offset = 0;
-        while (point_num > 0) {
-            int trans_points = point_num > gap_point ? gap_point : point_num;
-
-            if (swap) {
-                for (int i = 0; i < trans_points; i++) {
-                    data_buf[i] = SWAPBYTES(buf[i + offset]);
-                }
-            } else {
-                memcpy((uint8_t*) data_buf, (uint8_t*) (buf + offset), trans_points * sizeof(uint16_t));
+    if (framebuffer != NULL) {
+        fbWrite(buf, 0, point_num, swap);
+        return;
+    }
+    // The pixels are copied, so the caller's buffer is free again on return while DMA is
+    // still sending them.
+    int offset = 0;
+    // Up to 16 words used to go out straight from the caller's buffer.
+    if (point_num * sizeof(uint16_t) > 16 * sizeof(uint32_t)) {
+        dma_allocs_saved++;
+    }
+    while (point_num > 0) {
+        int trans_points = point_num > dma_chunk ? dma_chunk : point_num;
+        int k = dmaBuf();
+        uint16_t *chunk = dma_buf[k];
+        if (swap) {
+            for (int i = 0; i < trans_points; i++) {
+                chunk[i] = SWAPBYTES(buf[i + offset]);
             }
-            transmitData((uint8_t*) (data_buf), trans_points * sizeof(uint16_t));
-            offset += trans_points;
-            point_num -= trans_points;
+        } else {
+            memcpy((uint8_t*) chunk, (uint8_t*) (buf + offset), trans_points * sizeof(uint16_t));
         }
-        free(data_buf);
-        data_buf = NULL;
+        sendDmaBuf(k, trans_points);
+        offset += trans_points;
+        point_num -= trans_points;
     }
 }
 
 void CMyLcd::_fastSendRep(uint16_t val, int rep_num)
 {
+    if (framebuffer != NULL) {
+        fbWrite(NULL, val, rep_num, false);
+        return;
+    }
+    if (rep_num <= 2) {
+        uint16_t data[2] = {val, val};
+        queueData(data, rep_num * sizeof(uint16_t));
+        return;
+    }
+    // The fill line is queued back to back as often as needed, and keeps its color for the
+    // next fill: clearing with the background again queues it as it is.
     int point_num = rep_num;
-    int gap_point = dma_buf_size;
-    gap_point = (gap_point > point_num ? point_num : gap_point);
-
-    uint16_t* data_buf = (uint16_t*) malloc(gap_point * sizeof(uint16_t));
-    int offset = 0;
+    int gap_point = MIN(LCD_FILL_PIXELS, point_num);
+    if (val != fill_color) {
+        waitTrans(fill_done);
+        fill_color = val;
+        fill_len = 0;
+    }
+    // DMA doesn't read past fill_len, so the line can grow while it is in flight.
+    for (; fill_len < gap_point; fill_len++) {
+        fill_buf[fill_len] = val;
+    }
+    dma_allocs_saved++;
     while (point_num > 0) {
-        for (int i = 0; i < gap_point; i++) {
-            data_buf[i] = val;
-        }
         int trans_points = point_num > gap_point ? gap_point : point_num;
-        transmitData((uint8_t*) (data_buf), sizeof(uint16_t) * trans_points);
-        offset += trans_points;
+        queueData(fill_buf, sizeof(uint16_t) * trans_points);
         point_num -= trans_points;
     }
-    free(data_buf);
-    data_buf = NULL;
+    fill_done = trans_seq;
 }
 
 void CMyLcd::drawBitmap(int16_t x, int16_t y, const uint16_t *bitmap, int16_t w, int16_t h)
@@ -233,6 +585,48 @@ void CMyLcd::fillDataFast(const uint16_t *pData, uint16_t size, bool swap)
 	xSemaphoreGiveRecursive(spi_mux);
 }
 
+void CMyLcd::fillDataAsync(const uint16_t *pData, uint16_t size, bool swap)
+{
+    if (!dma_mode) {
+        fillDataFast(pData, size, swap);
+        return;
+    }
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    if (framebuffer != NULL) {
+        fbWrite(pData, 0, size, swap);
+        xSemaphoreGiveRecursive(spi_mux);
+        return;
+    }
+    // The caller hands the buffer over until fillWait(), so swap it in place.
+    uint16_t *buf = (uint16_t *) pData;
+    if (swap) {
+        for (int i = 0; i < size; i++) {
+            buf[i] = SWAPBYTES(buf[i]);
+        }
+    }
+    uint8_t *data = (uint8_t *) buf;
+    int bytes = size * sizeof(uint16_t);
+    while (bytes > 0) {
+        int len = bytes > LCD_ASYNC_TRANS_MAX ? LCD_ASYNC_TRANS_MAX : bytes;
+        queueData(data, len);
+        data += len;
+        bytes -= len;
+    }
+    xSemaphoreGiveRecursive(spi_mux);
+}
+
+void CMyLcd::fillWait()
+{
+    if (trans_pending == 0) {
+        return;
+    }
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    while (trans_pending > 0) {
+        reapTrans();
+    }
+    xSemaphoreGiveRecursive(spi_mux);
+}
+
 esp_err_t CMyLcd::drawBitmapFromFlashPartition(int16_t x, int16_t y, int16_t w, int16_t h, esp_partition_t* data_partition, int data_offset, int malloc_pixal_size, bool swap_bytes_en)
 {
     if (data_partition == NULL) {
@@ -240,25 +634,35 @@ esp_err_t CMyLcd::drawBitmapFromFlashPartition(int16_t x, int16_t y, int16_t w,
         return ESP_FAIL;
     }
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
-    uint16_t* recv_buf = (uint16_t*) calloc(malloc_pixal_size, sizeof(uint16_t));
     setAddrWindow(x, y, x + w - 1, y + h - 1);
 
+    // Without scratch buffers, a few pixels at a time from the stack.
+    uint16_t small_buf[16];
+    bool scratch = (dma_buf[0] != NULL);
+    int chunk = MIN(malloc_pixal_size, scratch ? dma_chunk : (int) (sizeof(small_buf) / sizeof(small_buf[0])));
     int offset = 0;
     int point_num = w * h;
+    if (scratch) {
+        dma_allocs_saved++;
+    }
     while (point_num) {
-        int len = malloc_pixal_size > point_num ? point_num : malloc_pixal_size;
+        int len = chunk > point_num ? point_num : chunk;
+        int k = scratch ? dmaBuf() : -1;
+        uint16_t *recv_buf = scratch ? dma_buf[k] : small_buf;
         esp_partition_read(data_partition, data_offset + offset * sizeof(uint16_t), (uint8_t*) recv_buf, len * sizeof(uint16_t));
         if (swap_bytes_en) {
             for (int i = 0; i < len; i++) {
                 recv_buf[i] = SWAPBYTES(recv_buf[i]);
             }
         }
-        transmitData((uint8_t*) recv_buf, len * sizeof(uint16_t));
+        if (scratch) {
+            sendDmaBuf(k, len);
+        } else {
+            transmitData((uint8_t*) recv_buf, len * sizeof(uint16_t));
+        }
         offset += len;
         point_num -= len;
     }
-    free(recv_buf);
-    recv_buf = NULL;
     xSemaphoreGiveRecursive(spi_mux);
     return ESP_OK;
 }
@@ -357,6 +761,11 @@ void CMyLcd::scrollTo(uint16_t y)
 void CMyLcd::setRotation(uint8_t m)
 {
     uint8_t data = 0;
+    // Drawn areas go out in the rotation they were drawn in.
+    flush();
+    if (framebuffer != NULL) {
+        waitTrans(fb_done);
+    }
     rotation = m % 7;  //Can't be more than 6
     switch (rotation) {
     case 0:
@@ -395,7 +804,18 @@ void CMyLcd::setRotation(uint8_t m)
     	_height = m_height;
     	break;
     }
-    transmitCmdData(LCD_MADCTL, data, 1);
+    xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
+    madctl = data;
+    if (data != madctl_sent) {
+        transmitCmdData(LCD_MADCTL, data, 1);
+        madctl_sent = data;
+    }
+    if (framebuffer != NULL) {
+        // The old contents don't map onto the new layout, start from a blank frame and leave
+        // the panel alone until the caller redraws.
+        memset(framebuffer, 0, m_width * m_height * sizeof(uint16_t));
+    }
+    xSemaphoreGiveRecursive(spi_mux);
 }
 
 void CMyLcd::invertDisplay(bool i)
@@ -471,10 +891,26 @@ int CMyLcd::drawUnicodeSevSeg(uint16_t uniCode, uint16_t x, uint16_t y, uint8_t
 
     xSemaphoreTakeRecursive(spi_mux, portMAX_DELAY);
     setAddrWindow(x, y, x + w * 8 - 1, y + height - 1);
-    uint16_t* data_buf = (uint16_t*) malloc(dma_buf_size * sizeof(uint16_t));
+    if (dma_buf[0] == NULL) {
+        // No scratch buffers, send the pixels one by one.
+        for (int i = 0; i < height; i++) {
+            for (int j = 0; j < w; j++) {
+                line = *(flash_address + w * i + j);
+                for (int m = 0; m < 8; m++) {
+                    uint16_t color = ((line >> (7 - m)) & 0x1) ? textcolor : textbgcolor;
+                    transmitData(SWAPBYTES(color), 1);
+                }
+            }
+        }
+        xSemaphoreGiveRecursive(spi_mux);
+        return width + gap;
+    }
+    int k = dmaBuf();
+    uint16_t* data_buf = dma_buf[k];
     int point_num = w * height * 8;
     int idx = 0;
-    int trans_points = point_num > dma_buf_size ? dma_buf_size : point_num;
+    int trans_points = point_num > dma_chunk ? dma_chunk : point_num;
+    dma_allocs_saved++;
     for (int i = 0; i < height; i++) {
         for (int j = 0; j < w; j++) {
             line = *(flash_address + w * i + j);
@@ -486,17 +922,19 @@ int CMyLcd::drawUnicodeSevSeg(uint16_t uniCode, uint16_t x, uint16_t y, uint8_t
                 }
 
                 if (idx >= trans_points) {
-                    transmitData((uint8_t*) (data_buf), trans_points * sizeof(uint16_t));
+                    sendDmaBuf(k, trans_points);
                     point_num -= trans_points;
                     idx = 0;
-                    trans_points = point_num > dma_buf_size ? dma_buf_size : point_num;
+                    trans_points = point_num > dma_chunk ? dma_chunk : point_num;
+                    if (point_num > 0) {
+                        k = dmaBuf();
+                        data_buf = dma_buf[k];
+                    }
                 }
 
             }
         }
     }
-    free(data_buf);
-    data_buf = NULL;
     xSemaphoreGiveRecursive(spi_mux);
     return width + gap;
 }
@@ -101,6 +101,53 @@ void lcd_data(spi_device_handle_t spi, const uint8_t *data, int len, lcd_dc_t *d
     assert(ret == ESP_OK);              // Should have had no issues.
 }
 
+void lcd_trans_init(spi_transaction_t *t, lcd_dc_t *dc, int num, uint8_t dc_io)
+{
+    memset(t, 0, num * sizeof(spi_transaction_t));
+    for (int i = 0; i < num; i++) {
+        dc[i].dc_io = dc_io;
+        dc[i].dc_level = LCD_DATA_LEV;
+        t[i].user = (void *) &dc[i];    // The pre-transfer callback reads the level from here
+    }
+}
+
+void lcd_cmd_queue(spi_device_handle_t spi, spi_transaction_t *t, const uint8_t cmd)
+{
+    esp_err_t ret;
+    ((lcd_dc_t *) t->user)->dc_level = LCD_CMD_LEV;
+    t->flags = SPI_TRANS_USE_TXDATA;
+    t->length = 8;                      // Command is 8 bits
+    t->tx_data[0] = cmd;
+    ret = spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret == ESP_OK);
+}
+
+void lcd_data_queue(spi_device_handle_t spi, spi_transaction_t *t, const uint8_t *data, int len)
+{
+    esp_err_t ret;
+    ((lcd_dc_t *) t->user)->dc_level = LCD_DATA_LEV;
+    t->length = len * 8;                // Len is in bytes, transaction length is in bits.
+    if (len <= 4) {
+        t->flags = SPI_TRANS_USE_TXDATA;
+        memcpy(t->tx_data, data, len);  // Caller's buffer is free again on return
+    } else {
+        t->flags = 0;
+        t->tx_buffer = data;            // Data, must stay valid until the result is fetched
+    }
+    ret = spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret == ESP_OK);
+}
+
+void lcd_wait_queued(spi_device_handle_t spi, int num)
+{
+    esp_err_t ret;
+    spi_transaction_t *rtrans;
+    while (num-- > 0) {
+        ret = spi_device_get_trans_result(spi, &rtrans, portMAX_DELAY);
+        assert(ret == ESP_OK);
+    }
+}
+
 uint32_t lcd_init(lcd_conf_t* lcd_conf, spi_device_handle_t *spi_wr_dev, lcd_dc_t *dc, int dma_chan)
 {
     //Initialize non-SPI GPIOs
@@ -125,6 +172,7 @@ uint32_t lcd_init(lcd_conf_t* lcd_conf, spi_device_handle_t *spi_wr_dev, lcd_dc_
             .sclk_io_num = lcd_conf->pin_num_clk,
             .quadwp_io_num = -1,
             .quadhd_io_num = -1,
+            .max_transfer_sz = LCD_FRAME_TRANS_MAX,
         };
         spi_bus_initialize(lcd_conf->spi_host, &buscfg, dma_chan);
     }
@@ -134,7 +182,7 @@ uint32_t lcd_init(lcd_conf_t* lcd_conf, spi_device_handle_t *spi_wr_dev, lcd_dc_
         .clock_speed_hz = 1 * 1000 * 1000,        //Clock out frequency
         .mode = 0,                                //SPI mode 0
         .spics_io_num = lcd_conf->pin_num_cs,     //CS pin
-        .queue_size = 7,                          //We want to be able to queue 7 transactions at a time
+        .queue_size = LCD_TRANS_NUM,              //The whole transaction pool can be in flight
         .pre_cb = lcd_spi_pre_transfer_callback,  //Specify pre-transfer callback to handle D/C line
     };
 #if 0
@@ -1,371 +1,871 @@
-#include "bmpDec.h"
-#include "string.h"
-#include "esp_log.h"
-#include "esp_heap_caps.h"
-
-#define RGB_2_BYTES(a, b)      (((uint16_t)(a) << 8) | (b))
-#define RGB555_2_BYTES(a, b)   (((uint16_t)(a) << 9) | (((uint16_t)(b) & 0xE0) << 1 ) | ((b) & 0x1F))
-#define RGB_3_BYTES(a, b, c)   ((((uint16_t)(a) << 8) & 0xF800) | (((uint16_t)(b) << 3) & 0x07E0) | ((c) >> 3))
-
-static const char *TAG = "BMP_DEC";
-
-uint16_t ImgWidth = 0, ImgHeight = 0;
-
-#define PARALLEL_LINES         8
-
-esp_err_t bmp_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen)
-{
-	esp_err_t ret = ESP_OK;
-    uint16_t cnt = 0;
-	uint8_t color_byte;
-	uint16_t color = 0;
-	uint16_t pixel_cnt = 0;
-
-	uint8_t *databuf = NULL;
-	uint16_t readlen = 0;
-	uint16_t line_cnt = 0;
-	uint16_t *line_data = NULL;
-
-	uint16_t data_offset = 0;
-	uint8_t biCompression = 0;
-
-	uint8_t extra = 0;
-	uint16_t line_bytes = 0;
-	ImgArea_t ImgRect = {0, 0, 0, 0};
-
-	databuf = (uint8_t *)calloc(1, sizeof(BITMAPINFO));
-	assert(databuf != NULL);
-
-	FILE *f = fopen(path, "r"); // read only.
-	if(f == NULL) {
-		ESP_LOGE(TAG, "can't open file %s", path);
-		ret = ESP_FAIL;
-	} else {
-		readlen = fread(databuf, sizeof(BITMAPINFO), 1, f);
-		if(readlen > 0) {
-			BITMAPINFO *pbmp = (BITMAPINFO *)databuf;
-			// Copy data.
-			data_offset = pbmp->bmfHeader.bfOffBits;
-			color_byte = pbmp->bmiHeader.biBitCount >> 3;
-			biCompression = pbmp->bmiHeader.biCompression;
-			ImgHeight = pbmp->bmiHeader.biHeight;
-			ImgWidth = pbmp->bmiHeader.biWidth;
-			ESP_LOGI(TAG, "BMP, %dx%d, %dbit", (int)(pbmp->bmiHeader.biWidth), (int)(pbmp->bmiHeader.biHeight), (int)(pbmp->bmiHeader.biBitCount));
-
-			if(color_byte < 2 || color_byte > 4 ) {
-				ESP_LOGE(TAG, "unsupport %dbit color", (int)(pbmp->bmiHeader.biBitCount));
-				fclose(f);
-				ret = ESP_FAIL;
-				goto exit;
-			}
-			free(databuf);
-			databuf = NULL;
-
-			if((ImgWidth * color_byte) % 4)
-				line_bytes = ((ImgWidth * color_byte) / 4 + 1) * 4;
-			else
-				line_bytes = ImgWidth * color_byte;
-			extra = line_bytes - ImgWidth * color_byte;
-
-			ImgRect.left = 0;
-			ImgRect.top = 0;
-			ImgRect.right = ImgWidth - 1;
-			ImgRect.bottom = ImgHeight - 1;
-			if(pDrawPrepare(&ImgRect) != ESP_OK) {
-				ESP_LOGE(TAG, "BMP Size unsupport.");
-				fclose(f);
-				ret = ESP_FAIL;
-				goto exit;
-			}
-
-			fseek(f, data_offset, SEEK_SET);
-
-			databuf = (uint8_t *)malloc(line_bytes * PARALLEL_LINES);
-			line_data = (uint16_t *)heap_caps_malloc(ImgWidth * sizeof(uint16_t) * PARALLEL_LINES, MALLOC_CAP_DMA);
-			assert(line_data != NULL);
-
-			while((readlen = fread(databuf, sizeof(uint8_t), line_bytes * PARALLEL_LINES, f)) > 0) {
-				cnt = 0;
-				while(cnt < readlen) {
-					switch(color_byte) {
-					case 1:
-						//unsupport.
-						break;
-					case 2:
-						if(biCompression == BI_RGB) {
-							color = RGB555_2_BYTES(databuf[cnt + 1], databuf[cnt]);
-						} else {
-							color = RGB_2_BYTES(databuf[cnt + 1], databuf[cnt]);
-						}
-						break;
-					case 3:
-						color = RGB_3_BYTES(databuf[cnt + 2], databuf[cnt + 1], databuf[cnt]);
-						break;
-					case 4:
-						color = RGB_3_BYTES(databuf[cnt + 2], databuf[cnt + 1], databuf[cnt]);
-						// ... and ignore the databuf[cnt + 3].
-						break;
-					default:
-						//unsupport.
-						break;
-					}
-					cnt += color_byte;
-					line_data[pixel_cnt + line_cnt * ImgWidth] = color;
-					if( ++pixel_cnt >= ImgWidth) {
-						cnt += extra;
-						pixel_cnt = 0;
-						line_cnt ++;
-						if(line_cnt >= PARALLEL_LINES) {
-							pFillScreen(line_data, line_cnt * ImgWidth, true);
-							line_cnt = 0;
-						}
-					}
-				}
-			}
-			if(line_cnt > 0)
-				pFillScreen(line_data, line_cnt * ImgWidth, true);
-			fclose(f);
-		} else {
-			ESP_LOGE(TAG, "can't read data from %s", path);
-			fclose(f);
-			ret = ESP_FAIL;
-		}
-	}
-
-exit:
-	if(databuf != NULL) free(databuf);
-	heap_caps_free(line_data);
-	return ret;
-}		 
-
-//uint8_t minibmp_decode(uint8_t *filename,uint16_t x,uint16_t y,uint16_t width,uint16_t height,uint16_t acolor,uint8_t mode)
-//{
-//	FIL* f_bmp;
-//    uint16_t br;
-//	uint8_t  color_byte;
-//	uint16_t tx,ty,color;
-//
-//	uint8_t res;
-//	uint16_t i,j;
-//	uint8_t *databuf;
-//	uint16_t readlen=BMP_DBUF_SIZE;
-//
-//	uint8_t *bmpbuf;
-//	uint8_t biCompression=0;
-//
-//	uint16_t rowcnt;
-//	uint16_t rowlen;
-//	uint16_t rowpix=0;
-//	uint8_t rowadd;
-//
-//	uint16_t tmp_color;
-//
-//	uint8_t alphabend=0xff;
-//	uint8_t alphamode=mode>>6;
-//	BITMAPINFO *pbmp;
-//
-//	picinfo.S_Height=height;
-//	picinfo.S_Width=width;
-//
-//#if BMP_USE_MALLOC == 1
-//	databuf=(uint8_t*)pic_memalloc(readlen);
-//	if(databuf==NULL)return PIC_MEM_ERR;
-//	f_bmp=(FIL *)pic_memalloc(sizeof(FIL));
-//	if(f_bmp==NULL)
-//	{
-//		pic_memfree(databuf);
-//		return PIC_MEM_ERR;
-//	}
-//#else
-//	databuf=bmpreadbuf;
-//	f_bmp=&f_bfile;
-//#endif
-//	res=f_open(f_bmp,(const TCHAR*)filename,FA_READ);
-//	if(res==0)
-//	{
-//		f_read(f_bmp,databuf,sizeof(BITMAPINFO),(UINT*)&br);
-//		pbmp=(BITMAPINFO*)databuf;
-//		color_byte=pbmp->bmiHeader.biBitCount/8;
-//		biCompression=pbmp->bmiHeader.biCompression;
-//		picinfo.ImgHeight=pbmp->bmiHeader.biHeight;
-//		picinfo.ImgWidth=pbmp->bmiHeader.biWidth;
-//
-//		if((picinfo.ImgWidth*color_byte)%4)rowlen=((picinfo.ImgWidth*color_byte)/4+1)*4;
-//		else rowlen=picinfo.ImgWidth*color_byte;
-//		rowadd=rowlen-picinfo.ImgWidth*color_byte;
-//
-//		color=0;
-//		tx=0 ;
-//		ty=picinfo.ImgHeight-1;
-//		if(picinfo.ImgWidth<=picinfo.S_Width&&picinfo.ImgHeight<=picinfo.S_Height)
-//		{
-//			x+=(picinfo.S_Width-picinfo.ImgWidth)/2;
-//			y+=(picinfo.S_Height-picinfo.ImgHeight)/2;
-//			rowcnt=readlen/rowlen;
-//			readlen=rowcnt*rowlen;
-//			rowpix=picinfo.ImgWidth;
-//			f_lseek(f_bmp,pbmp->bmfHeader.bfOffBits);
-//			while(1)
-//			{
-//				res=f_read(f_bmp,databuf,readlen,(UINT *)&br);
-//				bmpbuf=databuf;
-//				if(br!=readlen)rowcnt=br/rowlen;
-//				if(color_byte==3)
-//				{
-//					for(j=0;j<rowcnt;j++)
-//					{
-//						for(i=0;i<rowpix;i++)
-//						{
-//							color=(*bmpbuf++)>>3;		   		 	//B
-//							color+=((uint16_t)(*bmpbuf++)<<3)&0X07E0;	//G
-//							color+=(((uint16_t)*bmpbuf++)<<8)&0XF800;	//R
-// 						 	pic_phy.draw_point(x+tx,y+ty,color);
-//							tx++;
-//						}
-//						bmpbuf+=rowadd;
-//						tx=0;
-//						ty--;
-//					}
-//				}else if(color_byte==2)
-//				{
-//					for(j=0;j<rowcnt;j++)
-//					{
-//						if(biCompression==BI_RGB)//RGB:5,5,5
-//						{
-//							for(i=0;i<rowpix;i++)
-//							{
-//								color=((uint16_t)*bmpbuf&0X1F);			//R
-//								color+=(((uint16_t)*bmpbuf++)&0XE0)<<1; 	//G
-//		 						color+=((uint16_t)*bmpbuf++)<<9;  	    //R,G
-//							    pic_phy.draw_point(x+tx,y+ty,color);
-//								tx++;
-//							}
-//						}else  //RGB 565
-//						{
-//							for(i=0;i<rowpix;i++)
-//							{
-//								color=*bmpbuf++;  			//G,B
-//		 						color+=((uint16_t)*bmpbuf++)<<8;	//R,G
-//							  	pic_phy.draw_point(x+tx,y+ty,color);
-//								tx++;
-//							}
-//						}
-//						bmpbuf+=rowadd;
-//						tx=0;
-//						ty--;
-//					}
-//				}else if(color_byte==4)
-//				{
-//					for(j=0;j<rowcnt;j++)
-//					{
-//						for(i=0;i<rowpix;i++)
-//						{
-//							color=(*bmpbuf++)>>3;		   		 	//B
-//							color+=((uint16_t)(*bmpbuf++)<<3)&0X07E0;	//G
-//							color+=(((uint16_t)*bmpbuf++)<<8)&0XF800;	//R
-//							alphabend=*bmpbuf++;
-//							if(alphamode!=1)
-//							{
-//								tmp_color=pic_phy.read_point(x+tx,y+ty);
-//							    if(alphamode==2)
-//								{
-//									tmp_color=piclib_alpha_blend(tmp_color,acolor,mode&0X1F);
-//								}
-//								color=piclib_alpha_blend(tmp_color,color,alphabend/8);
-//							}else tmp_color=piclib_alpha_blend(acolor,color,alphabend/8);
-// 							pic_phy.draw_point(x+tx,y+ty,color);
-//							tx++;
-//						}
-//						bmpbuf+=rowadd;
-//						tx=0;
-//						ty--;
-//					}
-//
-//				}
-//				if(br!=readlen||res)break;
-//			}
-//		}
-//		f_close(f_bmp);
-//	}else res=PIC_SIZE_ERR;
-//#if BMP_USE_MALLOC == 1
-//	pic_memfree(databuf);
-//	pic_memfree(f_bmp);
-//#endif
-//	return res;
-//}
-
-//uint8_t bmp_encode(uint8_t *filename, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t mode)
-//{
-//	FIL* f_bmp;
-//	uint16_t bmpheadsize;
-// 	BITMAPINFO hbmp;
-//	uint8_t res=0;
-//	uint16_t tx,ty;
-//	uint16_t *databuf;
-//	uint16_t pixcnt;
-//	uint16_t bi4width;
-//	if(width==0||height==0)return PIC_WINDOW_ERR;
-//	if((x+width-1)>lcddev.width)return PIC_WINDOW_ERR;
-//	if((y+height-1)>lcddev.height)return PIC_WINDOW_ERR;
-//
-//#if BMP_USE_MALLOC == 1
-//	databuf=(uint16_t*)pic_memalloc(1024);
-//	if(databuf==NULL)return PIC_MEM_ERR;
-//	f_bmp=(FIL *)pic_memalloc(sizeof(FIL));
-//	if(f_bmp==NULL)
-//	{
-//		pic_memfree(databuf);
-//		return PIC_MEM_ERR;
-//	}
-//#else
-//	databuf=(uint16_t *)bmpreadbuf;
-//	f_bmp = &f_bfile;
-//#endif
-//	bmpheadsize=sizeof(hbmp);
-//	mymemset((uint8_t *)&hbmp, 0, sizeof(hbmp));
-//	hbmp.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
-//	hbmp.bmiHeader.biWidth=width;
-//	hbmp.bmiHeader.biHeight=height;
-//	hbmp.bmiHeader.biPlanes=1;
-//	hbmp.bmiHeader.biBitCount=16;
-//	hbmp.bmiHeader.biCompression=BI_BITFIELDS;
-// 	hbmp.bmiHeader.biSizeImage=hbmp.bmiHeader.biHeight*hbmp.bmiHeader.biWidth*hbmp.bmiHeader.biBitCount/8;
-//
-//	hbmp.bmfHeader.bfType=((uint16_t)'M'<<8)+'B';
-//	hbmp.bmfHeader.bfSize=bmpheadsize+hbmp.bmiHeader.biSizeImage;
-//   	hbmp.bmfHeader.bfOffBits=bmpheadsize;
-//
-//	hbmp.RGB_MASK[0]=0X00F800;
-//	hbmp.RGB_MASK[1]=0X0007E0;
-//	hbmp.RGB_MASK[2]=0X00001F;
-//
-//	if(mode==1)res=f_open(f_bmp,(const TCHAR*)filename,FA_READ|FA_WRITE);
-// 	if(mode==0||res==0x04)res=f_open(f_bmp,(const TCHAR*)filename,FA_WRITE|FA_CREATE_NEW);
-// 	if((hbmp.bmiHeader.biWidth*2)%4)
-//	{
-//		bi4width=((hbmp.bmiHeader.biWidth*2)/4+1)*4;
-//	}else bi4width=hbmp.bmiHeader.biWidth*2;
-// 	if(res==FR_OK)
-//	{
-//		res=f_write(f_bmp,(uint8_t*)&hbmp,bmpheadsize,&bw);
-//		for(ty=y+height-1;hbmp.bmiHeader.biHeight;ty--)
-//		{
-//			pixcnt=0;
-// 			for(tx=x;pixcnt!=(bi4width/2);)
-//			{
-//				if(pixcnt<hbmp.bmiHeader.biWidth) databuf[pixcnt] = LCD_ReadPoint(tx,ty);
-//				else databuf[pixcnt] = 0Xffff;
-//				pixcnt ++;
-//				tx ++;
-//			}
-//			hbmp.bmiHeader.biHeight --;
-//			res = f_write(f_bmp, (uint8_t *)databuf, bi4width, &bw);
-//		}
-//		f_close(f_bmp);
-//	}
-//#if BMP_USE_MALLOC == 1
-//	pic_memfree(databuf);
-//	pic_memfree(f_bmp);
-//#endif
-//	return res;
-//}
+#include <assert.h>
+#include "bmpDec.h"
+#include "colorConv.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "BMP_DEC";
+
+uint16_t ImgWidth = 0, ImgHeight = 0;
+
+#define PARALLEL_LINES         8
+#define RLE_CHUNK_SIZE         512
+#define BMP_SEEK_GAP           512     // skip unused row bytes by seeking from this size on
+
+// Converts one row of file pixels to big-endian RGB565. lut is the palette
+// of indexed formats, NULL otherwise.
+typedef void (*BmpRowFunc_t)(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut);
+
+typedef enum {
+	BMP_FMT_555 = 0,
+	BMP_FMT_565,
+	BMP_FMT_888,
+	BMP_FMT_8888,
+	BMP_FMT_PAL1,
+	BMP_FMT_PAL4,
+	BMP_FMT_PAL8,
+	BMP_FMT_RLE4,
+	BMP_FMT_RLE8,
+	BMP_FMT_NUM,
+} BmpFormat_t;
+
+// x1111122 22233333 -> 11111222 22033333, little-endian in the file.
+static void bmp_row_555(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	while(width --) {
+		uint16_t v = ((uint16_t)in[1] << 9) | (((uint16_t)in[0] & 0xE0) << 1) | (in[0] & 0x1F);
+		*out ++ = (v >> 8) | (v << 8);
+		in += 2;
+	}
+}
+
+// Already RGB565, only the byte order differs.
+static void bmp_row_565(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	while(width --) {
+		*out ++ = ((uint16_t)in[0] << 8) | in[1];
+		in += 2;
+	}
+}
+
+static void bmp_row_888(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	bgr888_to_rgb565be(out, in, width);
+}
+
+// B, G, R, x. Rows start 4-byte aligned, so every pixel is one word.
+static void bmp_row_8888(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	if(((uintptr_t)in & 3) == 0) {
+		const uint32_t *src = (const uint32_t *)in;
+		while(width --) {
+			uint32_t w = *src ++;
+			*out ++ = RGB565BE((w >> 16) & 0xFF, (w >> 8) & 0xFF, w & 0xFF);
+		}
+	} else {
+		while(width --) {
+			*out ++ = RGB565BE(in[2], in[1], in[0]);
+			in += 4;
+		}
+	}
+}
+
+// Indexed rows, leftmost pixel in the most significant bits.
+static void bmp_row_pal1(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	uint16_t c0 = lut[0], c1 = lut[1];
+	for(; width >= 8; width -= 8) {
+		uint8_t b = *in ++;
+		for(int i = 7; i >= 0; i --)
+			*out ++ = ((b >> i) & 1) ? c1 : c0;
+	}
+	if(width) {
+		uint8_t b = *in;
+		for(; width > 0; width --, b <<= 1)
+			*out ++ = (b & 0x80) ? c1 : c0;
+	}
+}
+
+static void bmp_row_pal4(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	for(; width >= 2; width -= 2) {
+		uint8_t b = *in ++;
+		*out ++ = lut[b >> 4];
+		*out ++ = lut[b & 0x0F];
+	}
+	if(width)
+		*out = lut[*in >> 4];
+}
+
+static void bmp_row_pal8(uint16_t *out, const uint8_t *in, uint16_t width, const uint16_t *lut)
+{
+	while(width --)
+		*out ++ = lut[*in ++];
+}
+
+static const BmpRowFunc_t bmp_row_func[BMP_FMT_NUM] = {
+	[BMP_FMT_555]  = bmp_row_555,
+	[BMP_FMT_565]  = bmp_row_565,
+	[BMP_FMT_888]  = bmp_row_888,
+	[BMP_FMT_8888] = bmp_row_8888,
+	[BMP_FMT_PAL1] = bmp_row_pal1,
+	[BMP_FMT_PAL4] = bmp_row_pal4,
+	[BMP_FMT_PAL8] = bmp_row_pal8,
+	// RLE has no fixed row layout, see bmp_decode_rle().
+};
+
+static esp_err_t bmp_format(const BITMAPINFO *pbmp, BmpFormat_t *fmt)
+{
+	uint32_t comp = pbmp->bmiHeader.biCompression;
+	switch(pbmp->bmiHeader.biBitCount) {
+	case 1:
+		*fmt = BMP_FMT_PAL1;
+		return (comp == BI_RGB) ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+	case 4:
+		*fmt = (comp == BI_RLE4) ? BMP_FMT_RLE4 : BMP_FMT_PAL4;
+		return (comp == BI_RGB || comp == BI_RLE4) ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+	case 8:
+		*fmt = (comp == BI_RLE8) ? BMP_FMT_RLE8 : BMP_FMT_PAL8;
+		return (comp == BI_RGB || comp == BI_RLE8) ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+	case 16:
+		if(comp == BI_RGB) {
+			*fmt = BMP_FMT_555;
+		} else if(comp == BI_BITFIELDS) {
+			// Only the two layouts we can convert without shifting per mask.
+			*fmt = (pbmp->RGB_MASK[1] == 0x03E0) ? BMP_FMT_555 : BMP_FMT_565;
+		} else {
+			return ESP_ERR_NOT_SUPPORTED;
+		}
+		return ESP_OK;
+	case 24:
+		*fmt = BMP_FMT_888;
+		return ESP_OK;
+	case 32:
+		*fmt = BMP_FMT_8888;
+		return ESP_OK;
+	default:
+		return ESP_ERR_NOT_SUPPORTED;
+	}
+}
+
+// Convert the RGBQUAD color table once, so indexed pixels are a single lookup.
+// Entries the file doesn't define stay black.
+static esp_err_t bmp_load_palette(FILE *f, const BITMAPINFO *pbmp, uint16_t *lut)
+{
+	RGBQUAD quad[16];
+	uint32_t num = pbmp->bmiHeader.biClrUsed;
+	if(num == 0 || num > (1u << pbmp->bmiHeader.biBitCount))
+		num = 1u << pbmp->bmiHeader.biBitCount;
+
+	memset(lut, 0, 256 * sizeof(uint16_t));
+	if(fseek(f, sizeof(BITMAPFILEHEADER) + pbmp->bmiHeader.biSize, SEEK_SET) != 0)
+		return ESP_FAIL;
+	for(uint32_t i = 0; i < num; ) {
+		uint32_t n = ((num - i) < 16) ? (num - i) : 16;
+		if(fread(quad, sizeof(RGBQUAD), n, f) != n)
+			return ESP_FAIL;
+		for(uint32_t k = 0; k < n; k ++, i ++)
+			lut[i] = RGB565BE(quad[k].rgbRed, quad[k].rgbGreen, quad[k].rgbBlue);
+	}
+	return ESP_OK;
+}
+
+// Push a block of lines and return the buffer to fill next. In async mode the
+// block is queued and the next one is converted into the other buffer meanwhile.
+static uint16_t *bmp_flush(const ImgSink_t *sink, uint16_t **buf, int *idx, uint16_t size)
+{
+	if(sink->FillAsync == NULL) {
+		sink->FillScreen(buf[0], size, false);
+		return buf[0];
+	}
+	sink->FillWait();
+	sink->FillAsync(buf[*idx], size, false);
+	*idx ^= 1;
+	return buf[*idx];
+}
+
+// Output side of the decoder: rows are handed out one at a time from a block
+// of PARALLEL_LINES rows, which is pushed to the display once it is full.
+//
+// When the image is larger than the display it is shrunk by an integer
+// factor with a box filter in the same single pass: source rows are handed
+// out from one scratch row and summed into one accumulator row, which
+// becomes an output row every `scale` source rows. Boxes at the right and
+// last edges may be partial and are averaged over what they cover.
+typedef struct {
+	const ImgSink_t *sink;
+	uint16_t *buf[2];
+	int idx;
+	uint16_t *lines;        // block being filled
+	uint16_t cnt;           // rows handed out from it
+	uint16_t width;         // output row width
+	uint8_t scale;          // box size, 1 for no scaling
+	uint16_t srcWidth;
+	uint16_t *src;          // source row handed out, scale > 1 only
+	uint32_t *acc;          // r, g, b sums per output column
+	uint8_t accRows;        // source rows summed into acc
+	bool pending;           // src holds a row that isn't summed yet
+	uint16_t *crop;         // region decoding: row handed out instead of a block row
+	uint16_t cropLeft;      // first pixel of crop that is output
+	uint32_t skipRows;      // rows handed out before the region starts
+	bool cropPending;       // crop holds a row that isn't output yet
+} BmpOut_t;
+
+static uint16_t *bmp_block_row(BmpOut_t *out)
+{
+	if(out->cnt >= PARALLEL_LINES) {
+		out->lines = bmp_flush(out->sink, out->buf, &out->idx, out->cnt * out->width);
+		out->cnt = 0;
+	}
+	return out->lines + out->width * out->cnt ++;
+}
+
+static void bmp_scale_emit(BmpOut_t *out)
+{
+	uint16_t *row = bmp_block_row(out);
+	uint32_t *acc = out->acc;
+	uint32_t cols = out->scale;
+	for(uint16_t j = 0; j < out->width; j ++, acc += 3) {
+		if(j == out->width - 1)
+			cols = out->srcWidth - j * out->scale;
+		uint32_t n = cols * out->accRows;
+		uint16_t v = ((acc[0] / n) << 11) | ((acc[1] / n) << 5) | (acc[2] / n);
+		row[j] = (v >> 8) | (v << 8);
+	}
+	memset(out->acc, 0, out->width * 3 * sizeof(uint32_t));
+	out->accRows = 0;
+}
+
+static void bmp_crop_take(BmpOut_t *out)
+{
+	out->cropPending = false;
+	if(out->skipRows > 0) {
+		out->skipRows --;
+		return;
+	}
+	memcpy(bmp_block_row(out), out->crop + out->cropLeft, out->width * sizeof(uint16_t));
+}
+
+static void bmp_scale_add(BmpOut_t *out)
+{
+	const uint16_t *src = out->src;
+	const uint16_t *end = src + out->srcWidth;
+	uint32_t *acc = out->acc;
+	while(src < end) {
+		uint32_t r = 0, g = 0, b = 0;
+		for(int k = out->scale; k > 0 && src < end; k --) {
+			uint16_t v = *src ++;
+			v = (v >> 8) | (v << 8);
+			r += v >> 11;
+			g += (v >> 5) & 0x3F;
+			b += v & 0x1F;
+		}
+		acc[0] += r;
+		acc[1] += g;
+		acc[2] += b;
+		acc += 3;
+	}
+	out->pending = false;
+	if(++ out->accRows >= out->scale)
+		bmp_scale_emit(out);
+}
+
+// Return the next row to write source pixels into. Handing out a row
+// completes the previous one.
+static uint16_t *bmp_next_row(BmpOut_t *out)
+{
+	if(out->crop != NULL) {
+		if(out->cropPending)
+			bmp_crop_take(out);
+		out->cropPending = true;
+		return out->crop;
+	}
+	if(out->scale <= 1)
+		return bmp_block_row(out);
+	if(out->pending)
+		bmp_scale_add(out);
+	out->pending = true;
+	return out->src;
+}
+
+static void bmp_out_finish(BmpOut_t *out)
+{
+	if(out->cropPending)
+		bmp_crop_take(out);
+	if(out->pending)
+		bmp_scale_add(out);
+	if(out->accRows > 0)
+		bmp_scale_emit(out);
+	if(out->cnt > 0)
+		bmp_flush(out->sink, out->buf, &out->idx, out->cnt * out->width);
+	out->cnt = 0;
+	if(out->sink->FillAsync != NULL)
+		out->sink->FillWait();
+}
+
+// Smallest box size that makes the image fit the display.
+static uint8_t bmp_scale(uint16_t width, uint16_t height, LcdSize_t *sz)
+{
+	uint32_t scale = 1;
+	while(((width + scale - 1) / scale) > sz->width || ((height + scale - 1) / scale) > sz->height)
+		scale ++;
+	return (scale > 255) ? 0 : scale;
+}
+
+// Byte source for RLE data, refilled from the file a chunk at a time.
+typedef struct {
+	FILE *f;
+	uint8_t *buf;
+	uint32_t pos, len;
+} BmpStream_t;
+
+static inline int bmp_getc(BmpStream_t *s)
+{
+	if(s->pos >= s->len) {
+		s->len = fread(s->buf, 1, RLE_CHUNK_SIZE, s->f);
+		s->pos = 0;
+		if(s->len == 0) return -1;
+	}
+	return s->buf[s->pos ++];
+}
+
+// Expand RLE4/RLE8 data straight into the output rows. Pixels skipped by
+// delta and end-of-line codes, or missing from a truncated file, are given
+// palette entry 0.
+static void bmp_decode_rle(BmpStream_t *s, BmpOut_t *out, uint16_t height, const uint16_t *lut, bool rle4)
+{
+	uint16_t width = out->srcWidth;
+	uint16_t *row = bmp_next_row(out);
+	uint32_t x = 0, y = 0;
+	uint32_t tx, ty;
+	int c0, c1;
+
+	while(y < height) {
+		if((c0 = bmp_getc(s)) < 0 || (c1 = bmp_getc(s)) < 0) {
+			tx = 0;
+			ty = height;
+		} else if(c0 > 0) {
+			// Encoded run. RLE4 alternates the two nibbles of c1.
+			uint16_t a = lut[rle4 ? (c1 >> 4) : c1];
+			uint16_t b = lut[rle4 ? (c1 & 0x0F) : c1];
+			for(int i = 0; i < c0 && x < width; i ++)
+				row[x ++] = (i & 1) ? b : a;
+			continue;
+		} else if(c1 >= 3) {
+			// Absolute run of c1 indices, padded to a 16-bit boundary.
+			int bytes = rle4 ? (c1 + 1) / 2 : c1;
+			for(int i = 0; i < bytes; i ++) {
+				int v = bmp_getc(s);
+				if(v < 0) break;
+				if(rle4) {
+					if(x < width) row[x ++] = lut[v >> 4];
+					if(x < width && (i * 2 + 1) < c1) row[x ++] = lut[v & 0x0F];
+				} else if(x < width) {
+					row[x ++] = lut[v];
+				}
+			}
+			if(bytes & 1) bmp_getc(s);
+			continue;
+		} else if(c1 == 0) {
+			// End of line.
+			tx = 0;
+			ty = y + 1;
+		} else if(c1 == 1) {
+			// End of bitmap.
+			tx = 0;
+			ty = height;
+		} else {
+			// Delta, move right and up (down the file) without drawing.
+			int dx = bmp_getc(s), dy = bmp_getc(s);
+			if(dx < 0 || dy < 0) {
+				tx = 0;
+				ty = height;
+			} else {
+				tx = x + dx;
+				ty = y + dy;
+			}
+		}
+		// Fill up to (tx, ty).
+		while(y < ty && y < height) {
+			while(x < width) row[x ++] = lut[0];
+			if(++ y < height) row = bmp_next_row(out);
+			x = 0;
+		}
+		if(y < height) {
+			if(tx > width) tx = width;
+			while(x < tx) row[x ++] = lut[0];
+		}
+	}
+}
+
+// Read the rows of a region from uncompressed data. offset is the file
+// position of the first row of the region. Each row is read from the byte
+// holding the region's first pixel; when the rest of a row is at least
+// BMP_SEEK_GAP bytes it is seeked over instead of read.
+static esp_err_t bmp_read_region(FILE *f, BmpOut_t *out, BmpRowFunc_t row_func, const uint16_t *lut,
+		uint32_t offset, uint32_t line_bytes, uint16_t bpp, uint16_t left, uint16_t rows, ImgArena_t *arena)
+{
+	uint32_t bit = (uint32_t)left * bpp;
+	uint16_t skip = (bit & 7) / bpp;        // pixels before left in its byte
+	uint16_t width = skip + out->width;
+	uint32_t span = ((uint32_t)width * bpp + 7) >> 3;
+	bool seek = (line_bytes - span) >= BMP_SEEK_GAP;
+	uint32_t lines = seek ? 1 : PARALLEL_LINES;
+	uint32_t len = seek ? span : line_bytes;
+	esp_err_t ret = ESP_OK;
+
+	uint8_t *buf = (uint8_t *)arena_alloc(arena, len * lines, MALLOC_CAP_8BIT);
+	assert(buf != NULL);
+	if(skip > 0) {
+		// The row kernels start on a byte, convert from there and drop the head.
+		out->crop = (uint16_t *)arena_alloc(arena, width * sizeof(uint16_t), MALLOC_CAP_8BIT);
+		assert(out->crop != NULL);
+		out->cropLeft = skip;
+	}
+	if(!seek && fseek(f, offset, SEEK_SET) != 0)
+		ret = ESP_FAIL;
+	for(uint16_t y = 0; y < rows && ret == ESP_OK; ) {
+		uint32_t n = ((uint32_t)(rows - y) < lines) ? (rows - y) : lines;
+		if(seek && fseek(f, offset + (uint32_t)y * line_bytes + (bit >> 3), SEEK_SET) != 0) {
+			ret = ESP_FAIL;
+			break;
+		}
+		n = fread(buf, len, n, f);
+		if(n == 0) ret = ESP_FAIL;
+		for(uint32_t i = 0; i < n; i ++)
+			row_func(bmp_next_row(out), buf + i * len + (seek ? 0 : (bit >> 3)), width, lut);
+		y += n;
+	}
+	arena_free(arena, buf);
+	return ret;
+}
+
+static esp_err_t bmp_run(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags,
+		const ImgArea_t *roi, uint16_t dx, uint16_t dy, ImgArena_t *arena)
+{
+	esp_err_t ret = ESP_OK;
+	uint8_t *databuf = NULL;
+	uint16_t *lut = NULL;
+	uint32_t readlen = 0;
+
+	uint32_t data_offset = 0;
+	BmpFormat_t format;
+	BmpRowFunc_t row_func;
+	BmpOut_t out;
+
+	uint32_t line_bytes = 0;
+	uint32_t read_lines;
+	uint16_t bpp = 0;
+	uint16_t rows = 0;
+	ImgArea_t ImgRect = {0, 0, 0, 0, false};
+
+	memset(&out, 0, sizeof(out));
+	out.sink = sink;
+	databuf = (uint8_t *)arena_calloc(arena, sizeof(BITMAPINFO), MALLOC_CAP_8BIT);
+	assert(databuf != NULL);
+
+	FILE *f = fopen(path, "r"); // read only.
+	if(f == NULL) {
+		ESP_LOGE(TAG, "can't open file %s", path);
+		ret = ESP_FAIL;
+	} else {
+		readlen = fread(databuf, sizeof(BITMAPINFO), 1, f);
+		if(readlen > 0) {
+			BITMAPINFO *pbmp = (BITMAPINFO *)databuf;
+			// Copy data.
+			data_offset = pbmp->bmfHeader.bfOffBits;
+			// Positive height: rows are stored bottom-up. Negative: top-down.
+			ImgHeight = (pbmp->bmiHeader.biHeight < 0) ? -pbmp->bmiHeader.biHeight : pbmp->bmiHeader.biHeight;
+			ImgWidth = pbmp->bmiHeader.biWidth;
+			ImgRect.bottomUp = (pbmp->bmiHeader.biHeight > 0);
+			ESP_LOGI(TAG, "BMP, %dx%d, %dbit", (int)(pbmp->bmiHeader.biWidth), (int)(pbmp->bmiHeader.biHeight), (int)(pbmp->bmiHeader.biBitCount));
+
+			if(bmp_format(pbmp, &format) != ESP_OK) {
+				ESP_LOGE(TAG, "unsupport %dbit color", (int)(pbmp->bmiHeader.biBitCount));
+				fclose(f);
+				ret = ESP_FAIL;
+				goto exit;
+			}
+			row_func = bmp_row_func[format];
+			if(pbmp->bmiHeader.biBitCount <= 8) {
+				lut = (uint16_t *)arena_alloc(arena, 256 * sizeof(uint16_t), MALLOC_CAP_8BIT);
+				assert(lut != NULL);
+				if(bmp_load_palette(f, pbmp, lut) != ESP_OK) {
+					ESP_LOGE(TAG, "can't read color table from %s", path);
+					fclose(f);
+					ret = ESP_FAIL;
+					goto exit;
+				}
+			}
+			// Rows are padded to 4 bytes.
+			bpp = pbmp->bmiHeader.biBitCount;
+			line_bytes = ((ImgWidth * bpp + 31) >> 5) << 2;
+			arena_free(arena, databuf);
+			databuf = NULL;
+
+			out.srcWidth = ImgWidth;
+			if(roi == NULL) {
+				out.scale = bmp_scale(ImgWidth, ImgHeight, &size);
+				if(out.scale == 0) {
+					ESP_LOGE(TAG, "BMP Size unsupport.");
+					fclose(f);
+					ret = ESP_FAIL;
+					goto exit;
+				}
+				out.width = (ImgWidth + out.scale - 1) / out.scale;
+				ImgRect.left = 0;
+				ImgRect.top = 0;
+				ImgRect.right = out.width - 1;
+				ImgRect.bottom = (ImgHeight + out.scale - 1) / out.scale - 1;
+				if(flags & PICDEC_CENTER) {
+					uint16_t ox = (size.width - out.width) / 2, oy = (size.height - ImgRect.bottom - 1) / 2;
+					ImgRect.left += ox;
+					ImgRect.right += ox;
+					ImgRect.top += oy;
+					ImgRect.bottom += oy;
+				}
+			} else {
+				// Region at full size, clipped to the image and the display.
+				if(roi->left > roi->right || roi->top > roi->bottom || roi->left >= ImgWidth || roi->top >= ImgHeight
+						|| dx >= size.width || dy >= size.height) {
+					ESP_LOGE(TAG, "region outside the image");
+					fclose(f);
+					ret = ESP_ERR_INVALID_ARG;
+					goto exit;
+				}
+				out.scale = 1;
+				out.width = ((roi->right < ImgWidth) ? roi->right + 1 : ImgWidth) - roi->left;
+				if(out.width > size.width - dx) out.width = size.width - dx;
+				rows = ((roi->bottom < ImgHeight) ? roi->bottom + 1 : ImgHeight) - roi->top;
+				if(rows > size.height - dy) rows = size.height - dy;
+				ImgRect.left = dx;
+				ImgRect.top = dy;
+				ImgRect.right = dx + out.width - 1;
+				ImgRect.bottom = dy + rows - 1;
+			}
+			if(sink->DrawPrepare(&ImgRect) != ESP_OK) {
+				ESP_LOGE(TAG, "BMP Size unsupport.");
+				fclose(f);
+				ret = ESP_FAIL;
+				goto exit;
+			}
+
+			if(roi != NULL) {
+				// File rows of the region, bottom-up files store its last row first.
+				uint32_t first = ImgRect.bottomUp ? ImgHeight - roi->top - rows : roi->top;
+				for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+					out.buf[i] = (uint16_t *)arena_alloc(arena, out.width * sizeof(uint16_t) * PARALLEL_LINES, MALLOC_CAP_DMA);
+					assert(out.buf[i] != NULL);
+				}
+				out.lines = out.buf[0];
+				if(row_func != NULL) {
+					ret = bmp_read_region(f, &out, row_func, lut, data_offset + first * line_bytes, line_bytes, bpp, roi->left, rows, arena);
+				} else {
+					// RLE can't be seeked into: expand from the start, drop what is
+					// outside the region and stop after its last row.
+					databuf = (uint8_t *)arena_alloc(arena, RLE_CHUNK_SIZE, MALLOC_CAP_8BIT);
+					out.crop = (uint16_t *)arena_alloc(arena, ImgWidth * sizeof(uint16_t), MALLOC_CAP_8BIT);
+					assert(databuf != NULL && out.crop != NULL);
+					out.cropLeft = roi->left;
+					out.skipRows = first;
+					fseek(f, data_offset, SEEK_SET);
+					BmpStream_t stream = {f, databuf, 0, 0};
+					bmp_decode_rle(&stream, &out, first + rows, lut, format == BMP_FMT_RLE4);
+				}
+				bmp_out_finish(&out);
+				fclose(f);
+				goto exit;
+			}
+
+			fseek(f, data_offset, SEEK_SET);
+
+			// Source rows of images that get scaled down can be long, read them one at a time.
+			read_lines = (out.scale > 1) ? 1 : PARALLEL_LINES;
+			databuf = (uint8_t *)arena_alloc(arena, (row_func != NULL) ? line_bytes * read_lines : RLE_CHUNK_SIZE, MALLOC_CAP_8BIT);
+			assert(databuf != NULL);
+			for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+				out.buf[i] = (uint16_t *)arena_alloc(arena, out.width * sizeof(uint16_t) * PARALLEL_LINES, MALLOC_CAP_DMA);
+				assert(out.buf[i] != NULL);
+			}
+			out.lines = out.buf[0];
+			if(out.scale > 1) {
+				out.src = (uint16_t *)arena_alloc(arena, ImgWidth * sizeof(uint16_t), MALLOC_CAP_8BIT);
+				out.acc = (uint32_t *)arena_calloc(arena, out.width * 3 * sizeof(uint32_t), MALLOC_CAP_8BIT);
+				assert(out.src != NULL && out.acc != NULL);
+			}
+
+			if(row_func != NULL) {
+				while((readlen = fread(databuf, sizeof(uint8_t), line_bytes * read_lines, f)) >= line_bytes) {
+					const uint8_t *row = databuf;
+					for(uint32_t n = readlen / line_bytes; n > 0; n --) {
+						row_func(bmp_next_row(&out), row, ImgWidth, lut);
+						row += line_bytes;
+					}
+				}
+			} else {
+				BmpStream_t stream = {f, databuf, 0, 0};
+				bmp_decode_rle(&stream, &out, ImgHeight, lut, format == BMP_FMT_RLE4);
+			}
+			bmp_out_finish(&out);
+			fclose(f);
+		} else {
+			ESP_LOGE(TAG, "can't read data from %s", path);
+			fclose(f);
+			ret = ESP_FAIL;
+		}
+	}
+
+exit:
+	arena_free(arena, databuf);
+	arena_free(arena, lut);
+	arena_free(arena, out.buf[0]);
+	arena_free(arena, out.buf[1]);
+	arena_free(arena, out.src);
+	arena_free(arena, out.acc);
+	arena_free(arena, out.crop);
+	return ret;
+}
+
+esp_err_t bmp_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena)
+{
+	return bmp_run(path, sink, size, flags, NULL, 0, 0, arena);
+}
+
+esp_err_t bmp_decode_region(const char *path, const ImgSink_t *sink, LcdSize_t size, const ImgArea_t *src, uint16_t x, uint16_t y,
+		ImgArena_t *arena)
+{
+	return bmp_run(path, sink, size, 0, src, x, y, arena);
+}		 
+
+//uint8_t minibmp_decode(uint8_t *filename,uint16_t x,uint16_t y,uint16_t width,uint16_t height,uint16_t acolor,uint8_t mode)
+//{
+//	FIL* f_bmp;
+//    uint16_t br;
+//	uint8_t  color_byte;
+//	uint16_t tx,ty,color;
+//
+//	uint8_t res;
+//	uint16_t i,j;
+//	uint8_t *databuf;
+//	uint16_t readlen=BMP_DBUF_SIZE;
+//
+//	uint8_t *bmpbuf;
+//	uint8_t biCompression=0;
+//
+//	uint16_t rowcnt;
+//	uint16_t rowlen;
+//	uint16_t rowpix=0;
+//	uint8_t rowadd;
+//
+//	uint16_t tmp_color;
+//
+//	uint8_t alphabend=0xff;
+//	uint8_t alphamode=mode>>6;
+//	BITMAPINFO *pbmp;
+//
+//	picinfo.S_Height=height;
+//	picinfo.S_Width=width;
+//
+//#if BMP_USE_MALLOC == 1
+//	databuf=(uint8_t*)pic_memalloc(readlen);
+//	if(databuf==NULL)return PIC_MEM_ERR;
+//	f_bmp=(FIL *)pic_memalloc(sizeof(FIL));
+//	if(f_bmp==NULL)
+//	{
+//		pic_memfree(databuf);
+//		return PIC_MEM_ERR;
+//	}
+//#else
+//	databuf=bmpreadbuf;
+//	f_bmp=&f_bfile;
+//#endif
+//	res=f_open(f_bmp,(const TCHAR*)filename,FA_READ);
+//	if(res==0)
+//	{
+//		f_read(f_bmp,databuf,sizeof(BITMAPINFO),(UINT*)&br);
+//		pbmp=(BITMAPINFO*)databuf;
+//		color_byte=pbmp->bmiHeader.biBitCount/8;
+//		biCompression=pbmp->bmiHeader.biCompression;
+//		picinfo.ImgHeight=pbmp->bmiHeader.biHeight;
+//		picinfo.ImgWidth=pbmp->bmiHeader.biWidth;
+//
+//		if((picinfo.ImgWidth*color_byte)%4)rowlen=((picinfo.ImgWidth*color_byte)/4+1)*4;
+//		else rowlen=picinfo.ImgWidth*color_byte;
+//		rowadd=rowlen-picinfo.ImgWidth*color_byte;
+//
+//		color=0;
+//		tx=0 ;
+//		ty=picinfo.ImgHeight-1;
+//		if(picinfo.ImgWidth<=picinfo.S_Width&&picinfo.ImgHeight<=picinfo.S_Height)
+//		{
+//			x+=(picinfo.S_Width-picinfo.ImgWidth)/2;
+//			y+=(picinfo.S_Height-picinfo.ImgHeight)/2;
+//			rowcnt=readlen/rowlen;
+//			readlen=rowcnt*rowlen;
+//			rowpix=picinfo.ImgWidth;
+//			f_lseek(f_bmp,pbmp->bmfHeader.bfOffBits);
+//			while(1)
+//			{
+//				res=f_read(f_bmp,databuf,readlen,(UINT *)&br);
+//				bmpbuf=databuf;
+//				if(br!=readlen)rowcnt=br/rowlen;
+//				if(color_byte==3)
+//				{
+//					for(j=0;j<rowcnt;j++)
+//					{
+//						for(i=0;i<rowpix;i++)
+//						{
+//							color=(*bmpbuf++)>>3;		   		 	//B
+//							color+=((uint16_t)(*bmpbuf++)<<3)&0X07E0;	//G
+//							color+=(((uint16_t)*bmpbuf++)<<8)&0XF800;	//R
+// 						 	pic_phy.draw_point(x+tx,y+ty,color);
+//							tx++;
+//						}
+//						bmpbuf+=rowadd;
+//						tx=0;
+//						ty--;
+//					}
+//				}else if(color_byte==2)
+//				{
+//					for(j=0;j<rowcnt;j++)
+//					{
+//						if(biCompression==BI_RGB)//RGB:5,5,5
+//						{
+//							for(i=0;i<rowpix;i++)
+//							{
+//								color=((uint16_t)*bmpbuf&0X1F);			//R
+//								color+=(((uint16_t)*bmpbuf++)&0XE0)<<1; 	//G
+//		 						color+=((uint16_t)*bmpbuf++)<<9;  	    //R,G
+//							    pic_phy.draw_point(x+tx,y+ty,color);
+//								tx++;
+//							}
+//						}else  //RGB 565
+//						{
+//							for(i=0;i<rowpix;i++)
+//							{
+//								color=*bmpbuf++;  			//G,B
+//		 						color+=((uint16_t)*bmpbuf++)<<8;	//R,G
+//							  	pic_phy.draw_point(x+tx,y+ty,color);
+//								tx++;
+//							}
+//						}
+//						bmpbuf+=rowadd;
+//						tx=0;
+//						ty--;
+//					}
+//				}else if(color_byte==4)
+//				{
+//					for(j=0;j<rowcnt;j++)
+//					{
+//						for(i=0;i<rowpix;i++)
+//						{
+//							color=(*bmpbuf++)>>3;		   		 	//B
+//							color+=((uint16_t)(*bmpbuf++)<<3)&0X07E0;	//G
+//							color+=(((uint16_t)*bmpbuf++)<<8)&0XF800;	//R
+//							alphabend=*bmpbuf++;
+//							if(alphamode!=1)
+//							{
+//								tmp_color=pic_phy.read_point(x+tx,y+ty);
+//							    if(alphamode==2)
+//								{
+//									tmp_color=piclib_alpha_blend(tmp_color,acolor,mode&0X1F);
+//								}
+//								color=piclib_alpha_blend(tmp_color,color,alphabend/8);
+//							}else tmp_color=piclib_alpha_blend(acolor,color,alphabend/8);
+// 							pic_phy.draw_point(x+tx,y+ty,color);
+//							tx++;
+//						}
+//						bmpbuf+=rowadd;
+//						tx=0;
+//						ty--;
+//					}
+//
+//				}
+//				if(br!=readlen||res)break;
+//			}
+//		}
+//		f_close(f_bmp);
+//	}else res=PIC_SIZE_ERR;
+//#if BMP_USE_MALLOC == 1
+//	pic_memfree(databuf);
+//	pic_memfree(f_bmp);
+//#endif
+//	return res;
+//}
+
+//uint8_t bmp_encode(uint8_t *filename, uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t mode)
+//{
+//	FIL* f_bmp;
+//	uint16_t bmpheadsize;
+// 	BITMAPINFO hbmp;
+//	uint8_t res=0;
+//	uint16_t tx,ty;
+//	uint16_t *databuf;
+//	uint16_t pixcnt;
+//	uint16_t bi4width;
+//	if(width==0||height==0)return PIC_WINDOW_ERR;
+//	if((x+width-1)>lcddev.width)return PIC_WINDOW_ERR;
+//	if((y+height-1)>lcddev.height)return PIC_WINDOW_ERR;
+//
+//#if BMP_USE_MALLOC == 1
+//	databuf=(uint16_t*)pic_memalloc(1024);
+//	if(databuf==NULL)return PIC_MEM_ERR;
+//	f_bmp=(FIL *)pic_memalloc(sizeof(FIL));
+//	if(f_bmp==NULL)
+//	{
+//		pic_memfree(databuf);
+//		return PIC_MEM_ERR;
+//	}
+//#else
+//	databuf=(uint16_t *)bmpreadbuf;
+//	f_bmp = &f_bfile;
+//#endif
+//	bmpheadsize=sizeof(hbmp);
+//	mymemset((uint8_t *)&hbmp, 0, sizeof(hbmp));
+//	hbmp.bmiHeader.biSize=sizeof(BITMAPINFOHEADER);
+//	hbmp.bmiHeader.biWidth=width;
+//	hbmp.bmiHeader.biHeight=height;
+//	hbmp.bmiHeader.biPlanes=1;
+//	hbmp.bmiHeader.biBitCount=16;
+//	hbmp.bmiHeader.biCompression=BI_BITFIELDS;
+// 	hbmp.bmiHeader.biSizeImage=hbmp.bmiHeader.biHeight*hbmp.bmiHeader.biWidth*hbmp.bmiHeader.biBitCount/8;
+//
+//	hbmp.bmfHeader.bfType=((uint16_t)'M'<<8)+'B';
+//	hbmp.bmfHeader.bfSize=bmpheadsize+hbmp.bmiHeader.biSizeImage;
+//   	hbmp.bmfHeader.bfOffBits=bmpheadsize;
+//
+//	hbmp.RGB_MASK[0]=0X00F800;
+//	hbmp.RGB_MASK[1]=0X0007E0;
+//	hbmp.RGB_MASK[2]=0X00001F;
+//
+//	if(mode==1)res=f_open(f_bmp,(const TCHAR*)filename,FA_READ|FA_WRITE);
+// 	if(mode==0||res==0x04)res=f_open(f_bmp,(const TCHAR*)filename,FA_WRITE|FA_CREATE_NEW);
+// 	if((hbmp.bmiHeader.biWidth*2)%4)
+//	{
+//		bi4width=((hbmp.bmiHeader.biWidth*2)/4+1)*4;
+//	}else bi4width=hbmp.bmiHeader.biWidth*2;
+// 	if(res==FR_OK)
+//	{
+//		res=f_write(f_bmp,(uint8_t*)&hbmp,bmpheadsize,&bw);
+//		for(ty=y+height-1;hbmp.bmiHeader.biHeight;ty--)
+//		{
+//			pixcnt=0;
+// 			for(tx=x;pixcnt!=(bi4width/2);)
+//			{
+//				if(pixcnt<hbmp.bmiHeader.biWidth) databuf[pixcnt] = LCD_ReadPoint(tx,ty);
+//				else databuf[pixcnt] = 0Xffff;
+//				pixcnt ++;
+//				tx ++;
+//			}
+//			hbmp.bmiHeader.biHeight --;
+//			res = f_write(f_bmp, (uint8_t *)databuf, bi4width, &bw);
+//		}
+//		f_close(f_bmp);
+//	}
+//#if BMP_USE_MALLOC == 1
+//	pic_memfree(databuf);
+//	pic_memfree(f_bmp);
+//#endif
+//	return res;
+//}
@@ -6,6 +6,7 @@
 #include "esp_err.h"
 #include "esp_system.h"
 #include "ll_config.h"
+#include "imgArena.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,14 +20,14 @@ extern "C" {
 
 typedef struct {
     uint32_t biSize;
-    long biWidth;
-    long biHeight;
+    int32_t biWidth;
+    int32_t biHeight;
     uint16_t biPlanes;
     uint16_t biBitCount;
     uint32_t biCompression;
     uint32_t biSizeImage;
-    long biXPelsPerMeter;
-    long biYPelsPerMeter;
+    int32_t biXPelsPerMeter;
+    int32_t biYPelsPerMeter;
     uint32_t biClrUsed;
     uint32_t biClrImportant;
 } __attribute__((packed)) BITMAPINFOHEADER;
@@ -60,7 +61,24 @@ typedef RGBQUAD * LPRGBQUAD; // color table
 #define BI_BITFIELDS 	3
 
 // Export functions.
-esp_err_t bmp_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen);
+/**
+ * @brief Decode a BMP file onto the display.
+ * @param size display size. Larger images are shrunk by the smallest integer
+ *        factor that makes them fit.
+ * @param flags PICDEC_CENTER to center the image on the display.
+ * @param arena scratch memory for the row and line buffers, NULL to use the heap.
+ */
+esp_err_t bmp_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena);
+/**
+ * @brief Decode part of a BMP file at full size.
+ *
+ * Only the rows of the region are read, each from the byte holding its first
+ * pixel. RLE data is expanded from the start up to the region's last row.
+ * @param src region in image pixels, clipped to the image
+ * @param x, y display position of the region, which is clipped to the display
+ */
+esp_err_t bmp_decode_region(const char *path, const ImgSink_t *sink, LcdSize_t size, const ImgArea_t *src, uint16_t x, uint16_t y,
+		ImgArena_t *arena);
 //uint8_t minibmp_decode(uint8_t *filename,uint16_t x,uint16_t y,uint16_t width,uint16_t height,uint16_t acolor,uint8_t mode);
 //uint8_t bmp_encode(uint8_t *filename,uint16_t x,uint16_t y,uint16_t width,uint16_t height,uint8_t mode);
 
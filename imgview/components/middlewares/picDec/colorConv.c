@@ -0,0 +1,119 @@
+#include "colorConv.h"
+
+// Four pixels from three aligned words into two. Bytes b0..b11 are the input
+// in memory order; bgr selects B, G, R instead of R, G, B channel order and is
+// a constant in every caller, so the selects fold away.
+static inline void pack4_888(uint32_t *dst, const uint32_t *src, const int bgr)
+{
+	uint32_t w0 = src[0], w1 = src[1], w2 = src[2];
+	uint32_t b0 = w0 & 0xFF, b1 = (w0 >> 8) & 0xFF, b2 = (w0 >> 16) & 0xFF;
+	uint32_t b3 = w0 >> 24, b4 = w1 & 0xFF, b5 = (w1 >> 8) & 0xFF;
+	uint32_t b6 = (w1 >> 16) & 0xFF, b7 = w1 >> 24, b8 = w2 & 0xFF;
+	uint32_t b9 = (w2 >> 8) & 0xFF, b10 = (w2 >> 16) & 0xFF, b11 = w2 >> 24;
+	if(bgr) {
+		dst[0] = RGB565BE(b2, b1, b0) | ((uint32_t)RGB565BE(b5, b4, b3) << 16);
+		dst[1] = RGB565BE(b8, b7, b6) | ((uint32_t)RGB565BE(b11, b10, b9) << 16);
+	} else {
+		dst[0] = RGB565BE(b0, b1, b2) | ((uint32_t)RGB565BE(b3, b4, b5) << 16);
+		dst[1] = RGB565BE(b6, b7, b8) | ((uint32_t)RGB565BE(b9, b10, b11) << 16);
+	}
+}
+
+static inline void convert_888(uint16_t *out, const uint8_t *in, uint32_t n, const int bgr)
+{
+	if((((uintptr_t)in | (uintptr_t)out) & 3) == 0) {
+		const uint32_t *src = (const uint32_t *)in;
+		uint32_t *dst = (uint32_t *)out;
+		while(n >= 4) {
+			pack4_888(dst, src, bgr);
+			src += 3;
+			dst += 2;
+			n -= 4;
+		}
+		in = (const uint8_t *)src;
+		out = (uint16_t *)dst;
+	}
+	while(n --) {
+		*out ++ = bgr ? RGB565BE(in[2], in[1], in[0]) : RGB565BE(in[0], in[1], in[2]);
+		in += 3;
+	}
+}
+
+void rgb888_to_rgb565be(uint16_t *out, const uint8_t *in, uint32_t n)
+{
+	convert_888(out, in, n, 0);
+}
+
+void bgr888_to_rgb565be(uint16_t *out, const uint8_t *in, uint32_t n)
+{
+	convert_888(out, in, n, 1);
+}
+
+// 4x4 Bayer matrix scaled to the step of a 5-bit (8) and a 6-bit (4) channel.
+static const uint8_t dither5[4][4] = {
+	{0, 4, 1, 5},
+	{6, 2, 7, 3},
+	{1, 5, 0, 4},
+	{7, 3, 6, 2},
+};
+static const uint8_t dither6[4][4] = {
+	{0, 2, 0, 2},
+	{3, 1, 3, 1},
+	{0, 2, 0, 2},
+	{3, 1, 3, 1},
+};
+
+// A channel plus its threshold, saturated. A single minu on the ESP32.
+static inline uint32_t dither_add(uint32_t c, uint32_t t)
+{
+	c += t;
+	return (c > 0xFF) ? 0xFF : c;
+}
+
+void rgb888_to_rgb565be_dither(uint16_t *out, const uint8_t *in, uint32_t n, uint32_t x, uint32_t y)
+{
+	const uint8_t *t5 = dither5[y & 3], *t6 = dither6[y & 3];
+	while(n --) {
+		uint32_t i = x ++ & 3;
+		uint32_t r = dither_add(in[0], t5[i]);
+		uint32_t g = dither_add(in[1], t6[i]);
+		uint32_t b = dither_add(in[2], t5[i]);
+		*out ++ = RGB565BE(r, g, b);
+		in += 3;
+	}
+}
+
+// Both pixels of a word between wire order and native order.
+static inline uint32_t swap2(uint32_t w)
+{
+	return ((w >> 8) & 0x00FF00FF) | ((w & 0x00FF00FF) << 8);
+}
+
+// Two native RGB565 pixels at once. The first mask holds R and B of the low
+// pixel and G of the high one, the second, shifted down 5 bits, G of the low
+// pixel and R and B of the high one. Weights of at most 32 add 5 bits to a
+// channel, which fit in the gaps both masks leave.
+static inline uint32_t blend2_565(uint32_t a, uint32_t b, uint32_t alpha)
+{
+	uint32_t inv = RGB565_ALPHA_MAX - alpha;
+	uint32_t m1 = (((a & 0x07E0F81F) * alpha + (b & 0x07E0F81F) * inv) >> 5) & 0x07E0F81F;
+	uint32_t m2 = ((((a >> 5) & 0x07C0F83F) * alpha + ((b >> 5) & 0x07C0F83F) * inv) >> 5) & 0x07C0F83F;
+	return m1 | (m2 << 5);
+}
+
+void rgb565be_blend(uint16_t *out, const uint16_t *a, const uint16_t *b, uint32_t n, uint8_t alpha)
+{
+	if(alpha > RGB565_ALPHA_MAX) alpha = RGB565_ALPHA_MAX;
+	if((((uintptr_t)out | (uintptr_t)a | (uintptr_t)b) & 3) == 0) {
+		uint32_t *dst = (uint32_t *)out;
+		const uint32_t *wa = (const uint32_t *)a, *wb = (const uint32_t *)b;
+		for(; n >= 2; n -= 2)
+			*dst ++ = swap2(blend2_565(swap2(*wa ++), swap2(*wb ++), alpha));
+		out = (uint16_t *)dst;
+		a = (const uint16_t *)wa;
+		b = (const uint16_t *)wb;
+	}
+	// One pixel in the low half of a word, the high half stays zero.
+	while(n --)
+		*out ++ = (uint16_t)swap2(blend2_565(swap2(*a ++), swap2(*b ++), alpha));
+}
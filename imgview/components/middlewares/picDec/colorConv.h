@@ -0,0 +1,62 @@
+#ifndef __COLOR_CONV_H
+#define __COLOR_CONV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pixel format conversion into what the LCD expects on the wire: RGB565 in
+ * big-endian byte order. The results are meant to be sent with swap = false.
+ * Both the ESP32 and the hosts we benchmark on are little-endian, so a
+ * big-endian pixel read back as uint16_t has its bytes swapped.
+ */
+
+// Big-endian RGB565 from 8-bit channels, as a little-endian uint16_t.
+#define RGB565BE(r, g, b)   ((uint16_t)(((r) & 0xF8) | ((g) >> 5) | (((((g) & 0x1C) << 3) | ((b) >> 3)) << 8)))
+
+/**
+ * @brief Convert RGB888 pixels (R, G, B byte order, as emitted by tjpgd) to
+ *        big-endian RGB565.
+ *
+ * Converts four pixels per iteration with three word loads and two word
+ * stores when both buffers are 32-bit aligned, pixel by pixel otherwise.
+ */
+void rgb888_to_rgb565be(uint16_t *out, const uint8_t *in, uint32_t n);
+
+/**
+ * @brief Same as rgb888_to_rgb565be() for B, G, R byte order (24-bit BMP rows).
+ */
+void bgr888_to_rgb565be(uint16_t *out, const uint8_t *in, uint32_t n);
+
+/**
+ * @brief Same as rgb888_to_rgb565be() with a 4x4 ordered dither instead of
+ *        truncation, for n pixels of a row starting at (x, y).
+ *
+ * A threshold from a table indexed by (x & 3, y & 3) is added to each
+ * channel before it is cut to 5 or 6 bits, which turns the bands of smooth
+ * gradients into a fine, stable pattern. The position should be the one on
+ * the display so neighbouring blocks line up.
+ */
+void rgb888_to_rgb565be_dither(uint16_t *out, const uint8_t *in, uint32_t n, uint32_t x, uint32_t y);
+
+#define RGB565_ALPHA_MAX    32
+
+/**
+ * @brief Blend two lines of big-endian RGB565 pixels:
+ *        out = (a * alpha + b * (32 - alpha)) / 32 per channel.
+ *
+ * Two pixels per 32-bit word when all three buffers are 32-bit aligned: the
+ * channels of a word are split over two masks so every product has room to
+ * grow by 5 bits without reaching the next channel.
+ * @param alpha weight of a, 0 (all b) to RGB565_ALPHA_MAX (all a).
+ */
+void rgb565be_blend(uint16_t *out, const uint16_t *a, const uint16_t *b, uint32_t n, uint8_t alpha);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __COLOR_CONV_H */
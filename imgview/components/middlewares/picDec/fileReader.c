@@ -0,0 +1,94 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "fileReader.h"
+
+static const char *TAG = "FILE_READER";
+
+esp_err_t reader_open(FileReader_t *rd, const char *path, uint32_t block, ImgArena_t *arena)
+{
+	memset(rd, 0, sizeof(FileReader_t));
+	// Keep whole sectors so reads never straddle a FAT sector.
+	block = (block + 511) & ~511;
+	if(block == 0) block = PICDEC_READ_BLOCK;
+
+	rd->f = fopen(path, "r"); // read only.
+	if(rd->f == NULL) {
+		ESP_LOGE(TAG, "can't open file %s", path);
+		return ESP_FAIL;
+	}
+	// We do our own read-ahead, stdio buffering would only add a copy.
+	setvbuf(rd->f, NULL, _IONBF, 0);
+
+	// DMA capable, so the SD driver can transfer straight into it.
+	rd->buf = (uint8_t *)arena_alloc(arena, block, MALLOC_CAP_DMA);
+	if(rd->buf == NULL) {
+		ESP_LOGE(TAG, "Cannot allocate %d bytes read buffer", (int)block);
+		fclose(rd->f);
+		rd->f = NULL;
+		return ESP_ERR_NO_MEM;
+	}
+	rd->block = block;
+	rd->arena = arena;
+	return ESP_OK;
+}
+
+void reader_close(FileReader_t *rd)
+{
+	if(rd->f != NULL) fclose(rd->f);
+	arena_free(rd->arena, rd->buf);
+	rd->f = NULL;
+	rd->buf = NULL;
+}
+
+void reader_seek(FileReader_t *rd, uint32_t offset)
+{
+	rd->pos = offset;
+}
+
+// Load the block containing rd->pos. Returns false at end of file.
+static bool reader_fill(FileReader_t *rd)
+{
+	uint32_t base = rd->pos - (rd->pos % rd->block);
+	if(base == rd->base && rd->len != 0 && rd->len < rd->block) {
+		return false; // the buffered block is already the short last one.
+	}
+	if(rd->filePos != base) {
+		if(fseek(rd->f, base, SEEK_SET) != 0) return false;
+		rd->filePos = base;
+	}
+	rd->base = base;
+	rd->len = fread(rd->buf, 1, rd->block, rd->f);
+	rd->filePos += rd->len;
+	return rd->pos < rd->base + rd->len;
+}
+
+uint32_t reader_peek(FileReader_t *rd, const uint8_t **data)
+{
+	if(rd->pos < rd->base || rd->pos >= rd->base + rd->len) {
+		if(!reader_fill(rd)) return 0;
+	}
+	*data = rd->buf + (rd->pos - rd->base);
+	return rd->base + rd->len - rd->pos;
+}
+
+uint32_t reader_read(FileReader_t *rd, uint8_t *buf, uint32_t len)
+{
+	uint32_t done = 0;
+	if(buf == NULL) {
+		rd->pos += len;
+		return len;
+	}
+	while(done < len) {
+		if(rd->pos < rd->base || rd->pos >= rd->base + rd->len) {
+			if(!reader_fill(rd)) break;
+		}
+		uint32_t off = rd->pos - rd->base;
+		uint32_t n = rd->len - off;
+		if(n > len - done) n = len - done;
+		memcpy(buf + done, rd->buf + off, n);
+		done += n;
+		rd->pos += n;
+	}
+	return done;
+}
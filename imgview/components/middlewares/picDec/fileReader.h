@@ -0,0 +1,66 @@
+#ifndef __FILE_READER_H
+#define __FILE_READER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "ll_config.h"
+#include "imgArena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Buffered forward reader for image files.
+ *
+ * Data is fetched in blocks of `block` bytes at file offsets that are
+ * multiples of the block size, so with a block that divides the FAT cluster
+ * size every read covers whole sectors of a single cluster. Skips (buf ==
+ * NULL) only move the read position; a skip past the buffered block is
+ * turned into one seek, issued lazily by the next read that needs data.
+ */
+typedef struct {
+	FILE *f;
+	uint8_t *buf;        // read-ahead block
+	uint32_t block;      // block size in bytes
+	uint32_t base;       // file offset of buf[0]
+	uint32_t len;        // valid bytes in buf
+	uint32_t pos;        // logical read position (file offset)
+	uint32_t filePos;    // offset the FILE is positioned at
+	ImgArena_t *arena;   // buf comes from here, may be NULL
+} FileReader_t;
+
+esp_err_t reader_open(FileReader_t *rd, const char *path, uint32_t block, ImgArena_t *arena);
+void reader_close(FileReader_t *rd);
+
+/**
+ * @brief Read len bytes at the current position.
+ * @param buf destination, or NULL to skip len bytes without any I/O.
+ * @return number of bytes read (or skipped), short only at end of file.
+ */
+uint32_t reader_read(FileReader_t *rd, uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Move the read position to an absolute file offset. No I/O is done
+ *        until the next read.
+ */
+void reader_seek(FileReader_t *rd, uint32_t offset);
+
+/**
+ * @brief Look at the data buffered at the current position, loading its block
+ *        if needed. The position doesn't move, follow with a skip.
+ * @return bytes available at *data, 0 at end of file.
+ */
+uint32_t reader_peek(FileReader_t *rd, const uint8_t **data);
+
+static inline uint32_t reader_tell(FileReader_t *rd)
+{
+	return rd->pos;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FILE_READER_H */
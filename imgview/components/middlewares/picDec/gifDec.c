@@ -0,0 +1,438 @@
+#include <assert.h>
+#include "gifDec.h"
+#include "fileReader.h"
+#include "colorConv.h"
+#include "string.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "GIF_DEC";
+
+#define PARALLEL_LINES         8
+#define LZW_CODES              (1 << GIF_LZW_MAX_BITS)
+
+typedef struct {
+	FileReader_t rd;
+	const ImgSink_t *sink;
+	LcdSize_t size;
+	uint16_t ox, oy;            // display position of the logical screen
+
+	// LZW dictionary: every code is its prefix code plus one suffix byte.
+	uint16_t prefix[LZW_CODES];
+	uint8_t suffix[LZW_CODES];
+	uint8_t stack[LZW_CODES + 1];
+	uint8_t block[256];         // current data sub-block
+	uint16_t blockPos, blockLen;
+	uint32_t bits;              // code bit buffer
+	uint8_t nbits;
+	bool dataEnd;               // zero length sub-block seen
+
+	uint16_t gct[256];          // palettes, as big-endian RGB565
+	uint16_t lct[256];
+	uint8_t bgIndex;
+
+	// Graphic control of the next frame.
+	int transparent;            // palette index, -1 for none
+	uint8_t dispose;
+	uint16_t delay;             // 1/100 s
+
+	// Current frame.
+	GIFIMAGEDESC desc;
+	const uint16_t *lut;
+	bool interlace;
+	bool draw;                  // some of the frame is on the display
+	bool direct;                // whole frame in one window, no transparent pixels
+	uint16_t x0, y0;            // display position of the frame
+	uint16_t visWidth;          // columns on the display
+	uint16_t x, y, pass;        // next pixel, in frame coordinates
+	uint32_t rowsLeft;
+	uint8_t *index;             // one frame row of palette indexes
+	uint16_t indexSize;
+
+	uint16_t *buf[2];           // output blocks of PARALLEL_LINES display rows
+	int idx;
+	uint16_t *lines;
+	uint16_t cnt;
+
+	ImgArena_t *arena;          // this struct and its buffers, may be NULL
+} GifDev;
+
+// Push pixels from the current block. Same double buffering as the BMP decoder.
+static void gif_push(GifDev *gd, uint32_t pixels)
+{
+	const ImgSink_t *sink = gd->sink;
+	if(sink->FillAsync == NULL) {
+		sink->FillScreen(gd->lines, pixels, false);
+	} else {
+		sink->FillWait();
+		sink->FillAsync(gd->lines, pixels, false);
+		gd->idx ^= 1;
+		gd->lines = gd->buf[gd->idx];
+	}
+}
+
+static void gif_flush(GifDev *gd)
+{
+	if(gd->cnt > 0)
+		gif_push(gd, gd->cnt * gd->visWidth);
+	gd->cnt = 0;
+}
+
+// Synchronous point of the output: nothing queued any more, the window may move.
+static void gif_sync(GifDev *gd)
+{
+	gif_flush(gd);
+	if(gd->sink->FillAsync != NULL)
+		gd->sink->FillWait();
+}
+
+static esp_err_t gif_read(GifDev *gd, void *buf, uint32_t len)
+{
+	return (reader_read(&gd->rd, (uint8_t *)buf, len) == len) ? ESP_OK : ESP_FAIL;
+}
+
+static int gif_byte(GifDev *gd)
+{
+	uint8_t b;
+	return (reader_read(&gd->rd, &b, 1) == 1) ? b : -1;
+}
+
+// Skip data sub-blocks up to and including the terminator.
+static esp_err_t gif_skip_blocks(GifDev *gd)
+{
+	int len;
+	while((len = gif_byte(gd)) > 0) {
+		if(reader_read(&gd->rd, NULL, len) != (uint32_t)len)
+			return ESP_FAIL;
+	}
+	return (len == 0) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t gif_palette(GifDev *gd, uint16_t *lut, uint32_t num)
+{
+	memset(lut, 0, 256 * sizeof(uint16_t));
+	for(uint32_t i = 0; i < num; i += 64) {
+		uint32_t n = ((num - i) < 64) ? (num - i) : 64;
+		if(gif_read(gd, gd->block, n * 3) != ESP_OK)
+			return ESP_FAIL;
+		rgb888_to_rgb565be(lut + i, gd->block, n);
+	}
+	return ESP_OK;
+}
+
+static void gif_fill_rect(GifDev *gd, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+	ImgArea_t area = {x, x + w - 1, y, y + h - 1, false};
+	gif_sync(gd);
+	if(gd->sink->DrawPrepare(&area) != ESP_OK) return;
+	for(int i = 0; i < 2 && gd->buf[i] != NULL; i ++) {
+		for(uint32_t k = 0; k < (uint32_t)w * PARALLEL_LINES; k ++)
+			gd->buf[i][k] = color;
+	}
+	while(h > 0) {
+		uint16_t n = (h < PARALLEL_LINES) ? h : PARALLEL_LINES;
+		gif_push(gd, (uint32_t)n * w);
+		h -= n;
+	}
+	gif_sync(gd);
+}
+
+// Clip a frame rectangle to the display.
+static bool gif_clip(GifDev *gd, const GIFIMAGEDESC *d, uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h)
+{
+	uint32_t x0 = gd->ox + d->left, y0 = gd->oy + d->top;
+	if(x0 >= gd->size.width || y0 >= gd->size.height || d->width == 0 || d->height == 0)
+		return false;
+	*x = x0;
+	*y = y0;
+	*w = ((x0 + d->width) > gd->size.width) ? (gd->size.width - x0) : d->width;
+	*h = ((y0 + d->height) > gd->size.height) ? (gd->size.height - y0) : d->height;
+	return true;
+}
+
+// A whole frame row is in gd->index, draw its visible part.
+static void gif_row(GifDev *gd)
+{
+	uint16_t y = gd->y;
+	const uint16_t *lut = gd->lut;
+
+	if(gd->interlace) {
+		// Rows 0, 8, 16.. then 4, 12.. then 2, 6.. then 1, 3..
+		static const uint8_t start[4] = {0, 4, 2, 1}, step[4] = {8, 8, 4, 2};
+		gd->y += step[gd->pass];
+		while(gd->y >= gd->desc.height && ++ gd->pass < 4)
+			gd->y = start[gd->pass];
+	} else {
+		gd->y ++;
+	}
+	gd->rowsLeft --;
+	if(!gd->draw || (uint32_t)gd->y0 + y >= gd->size.height) return;
+
+	if(gd->direct) {
+		uint16_t *out = gd->lines + gd->cnt * gd->visWidth;
+		for(uint16_t i = 0; i < gd->visWidth; i ++)
+			out[i] = lut[gd->index[i]];
+		if(++ gd->cnt >= PARALLEL_LINES)
+			gif_flush(gd);
+		return;
+	}
+	// Transparent pixels keep what is on the display: draw each opaque run
+	// through its own one row window.
+	for(uint16_t a = 0; a < gd->visWidth; ) {
+		while(a < gd->visWidth && gd->index[a] == gd->transparent) a ++;
+		uint16_t b = a;
+		while(b < gd->visWidth && gd->index[b] != gd->transparent) b ++;
+		if(b > a) {
+			ImgArea_t area = {gd->x0 + a, gd->x0 + b - 1, gd->y0 + y, gd->y0 + y, false};
+			gif_sync(gd);
+			if(gd->sink->DrawPrepare(&area) == ESP_OK) {
+				for(uint16_t i = a; i < b; i ++)
+					gd->lines[i - a] = lut[gd->index[i]];
+				gif_push(gd, b - a);
+			}
+		}
+		a = b;
+	}
+}
+
+static inline void gif_pixel(GifDev *gd, uint8_t v)
+{
+	gd->index[gd->x ++] = v;
+	if(gd->x >= gd->desc.width) {
+		gd->x = 0;
+		gif_row(gd);
+	}
+}
+
+static int gif_code(GifDev *gd, uint8_t size)
+{
+	while(gd->nbits < size) {
+		if(gd->blockPos >= gd->blockLen) {
+			int len = gd->dataEnd ? 0 : gif_byte(gd);
+			if(len <= 0 || gif_read(gd, gd->block, len) != ESP_OK) {
+				gd->dataEnd = true;
+				return -1;
+			}
+			gd->blockPos = 0;
+			gd->blockLen = len;
+		}
+		gd->bits |= (uint32_t)gd->block[gd->blockPos ++] << gd->nbits;
+		gd->nbits += 8;
+	}
+	int code = gd->bits & ((1 << size) - 1);
+	gd->bits >>= size;
+	gd->nbits -= size;
+	return code;
+}
+
+// Decode the frame's image data straight from the file into rows.
+static esp_err_t gif_lzw(GifDev *gd, uint8_t minSize)
+{
+	uint16_t clear = 1 << minSize, eoi = clear + 1;
+	uint16_t next = eoi + 1;
+	uint8_t size = minSize + 1;
+	int prev = -1;
+	uint8_t first = 0;
+
+	if(minSize < 2 || minSize > 8) return ESP_FAIL;
+	for(uint16_t i = 0; i < clear; i ++)
+		gd->suffix[i] = i;
+	gd->bits = 0;
+	gd->nbits = 0;
+	gd->blockPos = gd->blockLen = 0;
+	gd->dataEnd = false;
+
+	while(gd->rowsLeft > 0) {
+		int code = gif_code(gd, size);
+		if(code < 0 || code == eoi) break;
+		if(code == clear) {
+			size = minSize + 1;
+			next = eoi + 1;
+			prev = -1;
+			continue;
+		}
+		if(prev < 0) {
+			if(code >= clear) return ESP_FAIL;
+			first = code;
+			prev = code;
+			gif_pixel(gd, code);
+			continue;
+		}
+		if(code > next) return ESP_FAIL;
+
+		// Walk the string back to its root, then emit it in order.
+		uint8_t *sp = gd->stack;
+		int c = code;
+		if(code == next) {
+			*sp ++ = first;
+			c = prev;
+		}
+		while(c >= clear) {
+			*sp ++ = gd->suffix[c];
+			c = gd->prefix[c];
+		}
+		*sp ++ = c;
+		first = c;
+		if(next < LZW_CODES) {
+			gd->prefix[next] = prev;
+			gd->suffix[next] = first;
+			if(++ next == (1 << size) && size < GIF_LZW_MAX_BITS)
+				size ++;
+		}
+		prev = code;
+		while(sp > gd->stack && gd->rowsLeft > 0)
+			gif_pixel(gd, *(-- sp));
+	}
+	// Skip what is left of the data, e.g. the EOI's sub-block terminator.
+	if(!gd->dataEnd)
+		return gif_skip_blocks(gd);
+	return ESP_OK;
+}
+
+static esp_err_t gif_frame(GifDev *gd)
+{
+	uint16_t w, h;
+	int minSize;
+
+	if(gif_read(gd, &gd->desc, sizeof(GIFIMAGEDESC)) != ESP_OK)
+		return ESP_FAIL;
+	gd->lut = gd->gct;
+	if(gd->desc.flags & GIF_LCT_PRESENT) {
+		if(gif_palette(gd, gd->lct, GIF_LCT_SIZE(gd->desc.flags)) != ESP_OK)
+			return ESP_FAIL;
+		gd->lut = gd->lct;
+	}
+	if((minSize = gif_byte(gd)) < 0)
+		return ESP_FAIL;
+
+	if(gd->desc.width > gd->indexSize) {
+		arena_free(gd->arena, gd->index);
+		gd->index = (uint8_t *)arena_alloc(gd->arena, gd->desc.width, MALLOC_CAP_8BIT);
+		assert(gd->index != NULL);
+		gd->indexSize = gd->desc.width;
+	}
+	gd->interlace = (gd->desc.flags & GIF_INTERLACE) != 0;
+	gd->x = gd->y = gd->pass = 0;
+	gd->rowsLeft = gd->desc.width ? gd->desc.height : 0;
+	gd->draw = gif_clip(gd, &gd->desc, &gd->x0, &gd->y0, &w, &h);
+	gd->direct = gd->draw && !gd->interlace && gd->transparent < 0;
+	gd->visWidth = gd->draw ? w : 0;
+	if(gd->direct) {
+		ImgArea_t area = {gd->x0, gd->x0 + w - 1, gd->y0, gd->y0 + h - 1, false};
+		gif_sync(gd);
+		if(gd->sink->DrawPrepare(&area) != ESP_OK)
+			gd->draw = gd->direct = false;
+	}
+
+	esp_err_t ret = gif_lzw(gd, minSize);
+	gif_sync(gd);
+	return ret;
+}
+
+esp_err_t gif_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena)
+{
+	esp_err_t ret = ESP_OK;
+	GIFHEADER hdr;
+	GifDev *gd = NULL;
+	int frames = 0;
+	GIFIMAGEDESC last;
+	uint8_t lastDispose = 0;
+	uint16_t lastDelay = 0;
+	int b;
+
+	gd = (GifDev *)arena_calloc(arena, sizeof(GifDev), MALLOC_CAP_8BIT);
+	if(gd == NULL) {
+		ESP_LOGE(TAG, "Cannot allocate decoder");
+		return ESP_ERR_NO_MEM;
+	}
+	gd->arena = arena;
+	ret = reader_open(&gd->rd, path, PICDEC_READ_BLOCK, arena);
+	if(ret != ESP_OK) {
+		arena_free(arena, gd);
+		return ret;
+	}
+	memset(&last, 0, sizeof(last));
+	gd->sink = sink;
+	gd->size = size;
+	gd->transparent = -1;
+
+	if(gif_read(gd, &hdr, sizeof(hdr)) != ESP_OK || memcmp(hdr.signature, "GIF", 3) != 0) {
+		ESP_LOGE(TAG, "not a gif file %s", path);
+		ret = ESP_FAIL;
+		goto exit;
+	}
+	ESP_LOGI(TAG, "GIF, %dx%d", hdr.width, hdr.height);
+	if(hdr.flags & GIF_GCT_PRESENT) {
+		if(gif_palette(gd, gd->gct, GIF_GCT_SIZE(hdr.flags)) != ESP_OK) {
+			ret = ESP_FAIL;
+			goto exit;
+		}
+	}
+	gd->bgIndex = hdr.bgIndex;
+	if(flags & PICDEC_CENTER) {
+		if(hdr.width < size.width) gd->ox = (size.width - hdr.width) / 2;
+		if(hdr.height < size.height) gd->oy = (size.height - hdr.height) / 2;
+	}
+
+	for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+		gd->buf[i] = (uint16_t *)arena_alloc(arena, size.width * sizeof(uint16_t) * PARALLEL_LINES, MALLOC_CAP_DMA);
+		if(gd->buf[i] == NULL) {
+			ESP_LOGE(TAG, "Cannot allocate line buffer");
+			ret = ESP_ERR_NO_MEM;
+			goto exit;
+		}
+	}
+	gd->lines = gd->buf[0];
+
+	while((b = gif_byte(gd)) >= 0 && b != GIF_TRAILER) {
+		if(b == GIF_EXTENSION) {
+			int label = gif_byte(gd);
+			if(label == GIF_EXT_GRAPHIC_CTRL) {
+				uint8_t gce[5];  // size, flags, delay, transparent index
+				if(gif_read(gd, gce, sizeof(gce)) != ESP_OK) break;
+				gd->dispose = (gce[1] >> 2) & 0x07;
+				gd->delay = gce[2] | (gce[3] << 8);
+				gd->transparent = (gce[1] & 0x01) ? gce[4] : -1;
+				if(gce[0] > 4)
+					reader_read(&gd->rd, NULL, gce[0] - 4);
+			}
+			if(gif_skip_blocks(gd) != ESP_OK) break;
+		} else if(b == GIF_IMAGE) {
+			if(frames > 0) {
+				uint16_t x, y, w, h;
+				if(sink->FrameDelay != NULL)
+					sink->FrameDelay(lastDelay * 10);
+				if(lastDispose == GIF_DISPOSE_BACKGROUND && gif_clip(gd, &last, &x, &y, &w, &h))
+					gif_fill_rect(gd, x, y, w, h, gd->gct[gd->bgIndex]);
+			}
+			if(gif_frame(gd) != ESP_OK) {
+				ESP_LOGE(TAG, "bad image data in frame %d", frames);
+				ret = ESP_FAIL;
+				break;
+			}
+			frames ++;
+			last = gd->desc;
+			lastDispose = gd->dispose;
+			lastDelay = gd->delay;
+			// Graphic control only applies to the frame that follows it.
+			gd->transparent = -1;
+			gd->dispose = 0;
+			gd->delay = 0;
+		} else {
+			ESP_LOGE(TAG, "unknown block 0x%02x", b);
+			break;
+		}
+	}
+	if(frames == 0 && ret == ESP_OK)
+		ret = ESP_FAIL;
+
+exit:
+	if(sink->FillAsync != NULL)
+		sink->FillWait();
+	reader_close(&gd->rd);
+	arena_free(arena, gd->index);
+	arena_free(arena, gd->buf[0]);
+	arena_free(arena, gd->buf[1]);
+	arena_free(arena, gd);
+	return ret;
+}
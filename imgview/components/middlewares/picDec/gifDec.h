@@ -0,0 +1,63 @@
+#ifndef __GIFDEC_H
+#define __GIFDEC_H
+
+#include "string.h"
+#include "stdio.h"
+#include "esp_err.h"
+#include "esp_system.h"
+#include "ll_config.h"
+#include "imgArena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	uint8_t signature[6];       // "GIF87a" or "GIF89a"
+	uint16_t width;             // logical screen
+	uint16_t height;
+	uint8_t flags;              // GIF_GCT_* bits
+	uint8_t bgIndex;
+	uint8_t aspect;
+} __attribute__((packed)) GIFHEADER;
+
+typedef struct {
+	uint16_t left;
+	uint16_t top;
+	uint16_t width;
+	uint16_t height;
+	uint8_t flags;              // GIF_LCT_* and GIF_INTERLACE bits
+} __attribute__((packed)) GIFIMAGEDESC;
+
+#define GIF_GCT_PRESENT         0x80
+#define GIF_GCT_SIZE(f)         (2 << ((f) & 0x07))
+#define GIF_LCT_PRESENT         0x80
+#define GIF_INTERLACE           0x40
+#define GIF_LCT_SIZE(f)         (2 << ((f) & 0x07))
+
+#define GIF_EXTENSION           0x21
+#define GIF_IMAGE               0x2C
+#define GIF_TRAILER             0x3B
+#define GIF_EXT_GRAPHIC_CTRL    0xF9
+
+#define GIF_DISPOSE_BACKGROUND  2
+
+#define GIF_LZW_MAX_BITS        12
+
+// Export functions.
+/**
+ * @brief Decode a GIF file onto the display, playing every frame once.
+ *
+ * Each frame only redraws its own rectangle. Between frames sink->FrameDelay
+ * (if set) is called with the delay of the frame just drawn. Images larger
+ * than the display are cropped.
+ * @param flags PICDEC_CENTER to center the image on the display.
+ * @param arena scratch memory for the decoder state and buffers, NULL to use the heap.
+ */
+esp_err_t gif_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GIFDEC_H */
@@ -0,0 +1,67 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "imgArena.h"
+
+static const char *TAG = "IMG_ARENA";
+
+esp_err_t arena_reserve(ImgArena_t *a, uint32_t size)
+{
+	arena_release(a);
+	if(size == 0) return ESP_OK;
+	size = (size + 3) & ~3;
+	a->base = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_DMA);
+	if(a->base == NULL) {
+		ESP_LOGE(TAG, "Cannot reserve %d bytes", (int)size);
+		return ESP_ERR_NO_MEM;
+	}
+	a->size = size;
+	return ESP_OK;
+}
+
+void arena_release(ImgArena_t *a)
+{
+	heap_caps_free(a->base);
+	memset(a, 0, sizeof(ImgArena_t));
+}
+
+void arena_reset(ImgArena_t *a)
+{
+	if(a == NULL) return;
+	a->used = 0;
+	a->last = 0;
+}
+
+void *arena_alloc(ImgArena_t *a, uint32_t size, uint32_t caps)
+{
+	size = (size + 3) & ~3;
+	if(a == NULL || a->base == NULL)
+		return heap_caps_malloc(size, caps);
+	if((caps & MALLOC_CAP_SPIRAM) || size > a->size - a->used) {
+		a->misses ++;
+		return heap_caps_malloc(size, caps);
+	}
+	void *p = a->base + a->used;
+	a->last = a->used;
+	a->used += size;
+	if(a->used > a->peak) a->peak = a->used;
+	return p;
+}
+
+void *arena_calloc(ImgArena_t *a, uint32_t size, uint32_t caps)
+{
+	void *p = arena_alloc(a, size, caps);
+	if(p != NULL) memset(p, 0, size);
+	return p;
+}
+
+void arena_free(ImgArena_t *a, void *p)
+{
+	if(p == NULL) return;
+	if(a == NULL || a->base == NULL || (uint8_t *)p < a->base || (uint8_t *)p >= a->base + a->size) {
+		heap_caps_free(p);
+		return;
+	}
+	if((uint8_t *)p == a->base + a->last)
+		a->used = a->last;
+}
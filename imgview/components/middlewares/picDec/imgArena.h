@@ -0,0 +1,57 @@
+#ifndef __IMG_ARENA_H
+#define __IMG_ARENA_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scratch memory kept across decodes.
+ *
+ * One DMA capable block is reserved up front and handed out by bumping a
+ * pointer; arena_reset() at the start of each decode takes it all back. So a
+ * slideshow that runs for days doesn't allocate and free the same work areas,
+ * line buffers and FIFOs thousands of times and fragment the heap.
+ *
+ * Requests that don't fit (or need memory the block can't provide, like
+ * SPIRAM) fall back to the heap and are counted, so the reserve can be sized
+ * from arena.peak and arena.misses. All functions accept a NULL arena and
+ * then simply use the heap.
+ */
+typedef struct {
+	uint8_t *base;
+	uint32_t size;
+	uint32_t used;
+	uint32_t last;          // offset of the most recent allocation
+	uint32_t peak;          // high-water mark of used since reserve
+	uint32_t misses;        // allocations that went to the heap instead
+} ImgArena_t;
+
+/**
+ * @brief Allocate the arena block, replacing any previous one.
+ * @param size bytes, 0 to release the block and use the heap only.
+ */
+esp_err_t arena_reserve(ImgArena_t *a, uint32_t size);
+void arena_release(ImgArena_t *a);
+
+// Give everything back, at the start of a decode.
+void arena_reset(ImgArena_t *a);
+
+/**
+ * @brief 4-byte aligned memory from the arena, or from heap_caps_malloc() if
+ *        it doesn't fit. Arena memory is DMA capable.
+ */
+void *arena_alloc(ImgArena_t *a, uint32_t size, uint32_t caps);
+void *arena_calloc(ImgArena_t *a, uint32_t size, uint32_t caps);
+
+// Free heap memory. Arena memory is only reclaimed if it was the last allocation.
+void arena_free(ImgArena_t *a, void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IMG_ARENA_H */
@@ -0,0 +1,155 @@
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "imgCache.h"
+
+static const char *TAG = "IMG_CACHE";
+
+esp_err_t cache_key(ImgCacheKey_t *key, const char *src, LcdSize_t size, uint8_t flags)
+{
+	struct stat st;
+	if(stat(src, &st) != 0)
+		return ESP_FAIL;
+	key->srcSize = st.st_size;
+	key->srcMtime = st.st_mtime;
+	key->size = size;
+	key->flags = flags;
+	return ESP_OK;
+}
+
+void cache_path(char *out, size_t len, const char *dir, const char *src)
+{
+	uint32_t h = 2166136261u;
+	while(*src != 0)
+		h = (h ^ (uint8_t)(*src ++)) * 16777619u;
+	snprintf(out, len, "%s/%08X.565", dir, (unsigned)h);
+}
+
+static bool cache_match(const ImgCacheHeader_t *hdr, const ImgCacheKey_t *key)
+{
+	if(hdr->magic != IMGCACHE_MAGIC || hdr->version != IMGCACHE_VERSION) return false;
+	if(hdr->srcSize != key->srcSize || hdr->srcMtime != key->srcMtime) return false;
+	if(hdr->lcdWidth != key->size.width || hdr->lcdHeight != key->size.height) return false;
+	if(hdr->flags != key->flags) return false;
+	if(hdr->width == 0 || hdr->height == 0) return false;
+	return (hdr->left + hdr->width <= key->size.width) && (hdr->top + hdr->height <= key->size.height);
+}
+
+esp_err_t cache_play(const char *path, const ImgCacheKey_t *key, const ImgSink_t *sink, ImgArena_t *arena)
+{
+	esp_err_t ret = ESP_OK;
+	ImgCacheHeader_t hdr;
+	uint16_t *buf[2] = {NULL, NULL};
+	int idx = 0;
+
+	FILE *f = fopen(path, "rb");
+	if(f == NULL)
+		return ESP_ERR_NOT_FOUND;
+	// Reads are large and sector aligned, let them go straight to the buffers.
+	setvbuf(f, NULL, _IONBF, 0);
+	if(fread(&hdr, 1, sizeof(hdr), f) != sizeof(hdr) || !cache_match(&hdr, key)) {
+		fclose(f);
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+		buf[i] = (uint16_t *)arena_alloc(arena, PICDEC_READ_BLOCK, MALLOC_CAP_DMA);
+		if(buf[i] == NULL) {
+			ESP_LOGE(TAG, "Cannot allocate read buffer");
+			ret = ESP_ERR_NO_MEM;
+			goto exit;
+		}
+	}
+	ImgArea_t area = {hdr.left, hdr.left + hdr.width - 1, hdr.top, hdr.top + hdr.height - 1, false};
+	if(fseek(f, IMGCACHE_DATA_OFFSET, SEEK_SET) != 0 || sink->DrawPrepare(&area) != ESP_OK) {
+		ret = ESP_FAIL;
+		goto exit;
+	}
+
+	uint32_t left = (uint32_t)hdr.width * hdr.height;
+	while(left > 0) {
+		uint32_t n = PICDEC_READ_BLOCK / sizeof(uint16_t);
+		if(n > left) n = left;
+		if(fread(buf[idx], sizeof(uint16_t), n, f) != n) {
+			ESP_LOGE(TAG, "%s is truncated", path);
+			ret = ESP_FAIL;
+			break;
+		}
+		if(sink->FillAsync == NULL) {
+			sink->FillScreen(buf[idx], n, false);
+		} else {
+			// The other buffer is still being sent while this one was read.
+			sink->FillWait();
+			sink->FillAsync(buf[idx], n, false);
+			idx ^= 1;
+		}
+		left -= n;
+	}
+
+exit:
+	if(sink->FillAsync != NULL)
+		sink->FillWait();
+	fclose(f);
+	arena_free(arena, buf[1]);
+	arena_free(arena, buf[0]);
+	return ret;
+}
+
+esp_err_t cache_store(const char *path, const ImgCacheKey_t *key, const ImgCanvas_t *cv)
+{
+	ImgCacheHeader_t hdr;
+	uint8_t pad[64];
+	bool ok = true;
+
+	if(!cv->drawn)
+		return ESP_ERR_INVALID_STATE;
+	FILE *f = fopen(path, "wb");
+	if(f == NULL) {
+		ESP_LOGE(TAG, "can't create %s", path);
+		return ESP_FAIL;
+	}
+	setvbuf(f, NULL, _IOFBF, PICDEC_READ_BLOCK);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.version = IMGCACHE_VERSION;
+	hdr.flags = key->flags;
+	hdr.lcdWidth = key->size.width;
+	hdr.lcdHeight = key->size.height;
+	hdr.left = cv->area.left;
+	hdr.top = cv->area.top;
+	hdr.width = cv->area.right - cv->area.left + 1;
+	hdr.height = cv->area.bottom - cv->area.top + 1;
+	hdr.srcSize = key->srcSize;
+	hdr.srcMtime = key->srcMtime;
+
+	// Header without its magic first, it is only made valid once the pixels are in.
+	memset(pad, 0, sizeof(pad));
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	for(uint32_t pos = sizeof(hdr); ok && pos < IMGCACHE_DATA_OFFSET; pos += sizeof(pad)) {
+		uint32_t n = IMGCACHE_DATA_OFFSET - pos;
+		if(n > sizeof(pad)) n = sizeof(pad);
+		ok = fwrite(pad, 1, n, f) == n;
+	}
+	const uint16_t *row = cv->pixels + hdr.top * cv->width + hdr.left;
+	if(hdr.width == cv->width) {
+		if(ok) ok = fwrite(row, sizeof(uint16_t) * hdr.width, hdr.height, f) == hdr.height;
+	} else {
+		for(uint16_t y = 0; ok && y < hdr.height; y ++, row += cv->width)
+			ok = fwrite(row, sizeof(uint16_t), hdr.width, f) == hdr.width;
+	}
+	hdr.magic = IMGCACHE_MAGIC;
+	if(ok && fflush(f) == 0 && fseek(f, 0, SEEK_SET) == 0)
+		ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	else
+		ok = false;
+	if(fclose(f) != 0)
+		ok = false;
+	if(!ok) {
+		ESP_LOGE(TAG, "can't write %s", path);
+		remove(path);
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
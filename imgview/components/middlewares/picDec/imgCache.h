@@ -0,0 +1,90 @@
+#ifndef __IMG_CACHE_H
+#define __IMG_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "ll_config.h"
+#include "imgCanvas.h"
+#include "imgArena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decoded image cache.
+ *
+ * A cache file holds the part of the display an image was drawn to, as
+ * big-endian RGB565 rows ready to be sent with swap = false. The header
+ * records what it was made from: size and mtime of the source file, the
+ * display size and the decode flags. A file that doesn't match all of them
+ * is stale and ignored.
+ *
+ * Cache files are named after a hash of the source path, 8.3 safe, so the
+ * cache directory works without long file name support in FatFs.
+ */
+
+#define IMGCACHE_MAGIC          0x35363543      // "C565"
+#define IMGCACHE_VERSION        1
+#define IMGCACHE_DATA_OFFSET    512             // pixels start on a sector boundary
+#define IMGCACHE_PATH_MAX       80
+
+typedef struct {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t flags;              // decode flags the image was drawn with
+	uint16_t lcdWidth;
+	uint16_t lcdHeight;
+	uint16_t left, top;         // drawn area
+	uint16_t width, height;
+	uint16_t reserved;
+	uint32_t srcSize;
+	uint32_t srcMtime;
+} __attribute__((packed)) ImgCacheHeader_t;
+
+typedef struct {
+	uint32_t srcSize;
+	uint32_t srcMtime;
+	LcdSize_t size;
+	uint8_t flags;
+} ImgCacheKey_t;
+
+/**
+ * @brief Describe the source image and how it is going to be drawn.
+ * @return ESP_FAIL if the source file can't be stat'ed.
+ */
+esp_err_t cache_key(ImgCacheKey_t *key, const char *src, LcdSize_t size, uint8_t flags);
+
+/**
+ * @brief Cache file name for a source image: dir/XXXXXXXX.565, from the
+ *        FNV-1a hash of the source path.
+ */
+void cache_path(char *out, size_t len, const char *dir, const char *src);
+
+/**
+ * @brief Draw a cached image.
+ *
+ * The pixels go out in large sequential reads straight into DMA capable
+ * buffers, double buffered when the sink has FillAsync. The buffers come
+ * from arena, or from the heap if it is NULL.
+ * @return
+ *     - ESP_ERR_NOT_FOUND no cache file, or a stale one. Nothing was drawn.
+ *     - ESP_FAIL the file is truncated or unreadable, part may have been drawn.
+ *     - ESP_OK on success
+ */
+esp_err_t cache_play(const char *path, const ImgCacheKey_t *key, const ImgSink_t *sink, ImgArena_t *arena);
+
+/**
+ * @brief Write the drawn area of a canvas as the cache file of key.
+ *
+ * The header is written last, so an interrupted write leaves a file that
+ * cache_play() treats as stale.
+ */
+esp_err_t cache_store(const char *path, const ImgCacheKey_t *key, const ImgCanvas_t *cv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IMG_CACHE_H */
@@ -0,0 +1,195 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "imgCanvas.h"
+
+static const char *TAG = "IMG_CANVAS";
+
+#define SWAPBYTES(i) ((uint16_t)(((i) >> 8) | ((i) << 8)))
+
+esp_err_t canvas_init(ImgCanvas_t *cv, uint16_t width, uint16_t height, uint32_t caps)
+{
+	memset(cv, 0, sizeof(ImgCanvas_t));
+	cv->pixels = (uint16_t *)heap_caps_malloc((uint32_t)width * height * sizeof(uint16_t), caps);
+	if(cv->pixels == NULL) {
+		ESP_LOGE(TAG, "Cannot allocate %dx%d canvas", width, height);
+		return ESP_ERR_NO_MEM;
+	}
+	cv->width = width;
+	cv->height = height;
+	return ESP_OK;
+}
+
+void canvas_free(ImgCanvas_t *cv)
+{
+	if(!cv->external)
+		heap_caps_free(cv->pixels);
+	cv->pixels = NULL;
+}
+
+void canvas_wrap(ImgCanvas_t *cv, uint16_t *pixels, uint16_t width, uint16_t height, bool native)
+{
+	memset(cv, 0, sizeof(ImgCanvas_t));
+	cv->pixels = pixels;
+	cv->width = width;
+	cv->height = height;
+	cv->native = native;
+	cv->external = true;
+}
+
+void canvas_reset(ImgCanvas_t *cv)
+{
+	cv->valid = false;
+	cv->drawn = false;
+}
+
+void canvas_clear(ImgCanvas_t *cv, uint16_t color)
+{
+	uint32_t n = (uint32_t)cv->width * cv->height;
+	if(cv->native) color = SWAPBYTES(color);
+	for(uint32_t i = 0; i < n; i ++)
+		cv->pixels[i] = color;
+	canvas_reset(cv);
+}
+
+esp_err_t canvas_prepare(ImgCanvas_t *cv, const ImgArea_t *area)
+{
+	cv->valid = false;
+	if(area->left > area->right || area->top > area->bottom) return ESP_FAIL;
+	if(area->right >= cv->width || area->bottom >= cv->height) return ESP_FAIL;
+
+	cv->win = *area;
+	cv->x = area->left;
+	cv->y = area->bottomUp ? area->bottom : area->top;
+	cv->valid = true;
+	if(!cv->drawn) {
+		cv->area = *area;
+		cv->area.bottomUp = false;
+		cv->drawn = true;
+	} else {
+		if(area->left < cv->area.left) cv->area.left = area->left;
+		if(area->right > cv->area.right) cv->area.right = area->right;
+		if(area->top < cv->area.top) cv->area.top = area->top;
+		if(area->bottom > cv->area.bottom) cv->area.bottom = area->bottom;
+	}
+	return ESP_OK;
+}
+
+void canvas_fill(ImgCanvas_t *cv, const uint16_t *data, uint32_t size, bool swap)
+{
+	// swap set means native data, which only a wire order canvas has to swap.
+	swap = (swap != cv->native);
+	while(size > 0 && cv->valid) {
+		uint32_t run = cv->win.right + 1 - cv->x;
+		if(run > size) run = size;
+		uint16_t *out = cv->pixels + cv->y * cv->width + cv->x;
+		if(swap) {
+			for(uint32_t i = 0; i < run; i ++)
+				out[i] = SWAPBYTES(data[i]);
+		} else {
+			memcpy(out, data, run * sizeof(uint16_t));
+		}
+		data += run;
+		size -= run;
+		cv->x += run;
+		if(cv->x > cv->win.right) {
+			// Like the LCD, pixels past the end of the window are dropped.
+			cv->x = cv->win.left;
+			cv->y += cv->win.bottomUp ? -1 : 1;
+			if(cv->y < cv->win.top || cv->y > cv->win.bottom)
+				cv->valid = false;
+		}
+	}
+}
+
+// The sink callbacks have no context argument.
+static ImgCanvas_t *sinkCanvas;
+static const ImgSink_t *sinkNext;
+
+static esp_err_t sink_prepare(ImgArea_t *area)
+{
+	if(sinkNext != NULL && sinkNext->DrawPrepare(area) != ESP_OK) {
+		sinkCanvas->valid = false;
+		return ESP_FAIL;
+	}
+	return canvas_prepare(sinkCanvas, area);
+}
+
+static void sink_fill(const uint16_t *data, uint16_t size, bool swap)
+{
+	canvas_fill(sinkCanvas, data, size, swap);
+	if(sinkNext != NULL)
+		sinkNext->FillScreen(data, size, swap);
+}
+
+// Copy before queueing: with swap set the transfer may swap the buffer in place.
+static void sink_fill_async(const uint16_t *data, uint16_t size, bool swap)
+{
+	canvas_fill(sinkCanvas, data, size, swap);
+	sinkNext->FillAsync(data, size, swap);
+}
+
+static void sink_wait(void)
+{
+	sinkNext->FillWait();
+}
+
+static void sink_delay(uint32_t ms)
+{
+	sinkNext->FrameDelay(ms);
+}
+
+void canvas_sink(ImgCanvas_t *cv, const ImgSink_t *next, ImgSink_t *sink)
+{
+	sinkCanvas = cv;
+	sinkNext = next;
+	sink->DrawPrepare = sink_prepare;
+	sink->FillScreen = sink_fill;
+	sink->FillAsync = (next != NULL && next->FillAsync != NULL) ? sink_fill_async : NULL;
+	sink->FillWait = (next != NULL && next->FillAsync != NULL) ? sink_wait : NULL;
+	sink->FrameDelay = (next != NULL && next->FrameDelay != NULL) ? sink_delay : NULL;
+}
+
+esp_err_t canvas_draw(const ImgCanvas_t *cv, const ImgSink_t *sink, ImgArena_t *arena)
+{
+	esp_err_t ret = ESP_OK;
+	uint16_t *buf[2] = {NULL, NULL};
+	int idx = 0;
+
+	for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+		buf[i] = (uint16_t *)arena_alloc(arena, PICDEC_READ_BLOCK, MALLOC_CAP_DMA);
+		if(buf[i] == NULL) {
+			ESP_LOGE(TAG, "Cannot allocate bounce buffer");
+			ret = ESP_ERR_NO_MEM;
+			goto exit;
+		}
+	}
+	ImgArea_t area = {0, (uint16_t)(cv->width - 1), 0, (uint16_t)(cv->height - 1), false};
+	if(sink->DrawPrepare(&area) != ESP_OK) {
+		ret = ESP_FAIL;
+		goto exit;
+	}
+
+	const uint16_t *src = cv->pixels;
+	for(uint32_t left = (uint32_t)cv->width * cv->height; left > 0; ) {
+		uint32_t n = PICDEC_READ_BLOCK / sizeof(uint16_t);
+		if(n > left) n = left;
+		memcpy(buf[idx], src, n * sizeof(uint16_t));
+		if(sink->FillAsync == NULL) {
+			sink->FillScreen(buf[idx], n, cv->native);
+		} else {
+			sink->FillWait();
+			sink->FillAsync(buf[idx], n, cv->native);
+			idx ^= 1;
+		}
+		src += n;
+		left -= n;
+	}
+
+exit:
+	if(sink->FillAsync != NULL)
+		sink->FillWait();
+	arena_free(arena, buf[1]);
+	arena_free(arena, buf[0]);
+	return ret;
+}
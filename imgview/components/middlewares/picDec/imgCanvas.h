@@ -0,0 +1,82 @@
+#ifndef __IMG_CANVAS_H
+#define __IMG_CANVAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ll_config.h"
+#include "imgArena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Display sized RGB565 frame in memory that behaves like the LCD's frame
+ * memory: canvas_prepare() sets the address window and canvas_fill() writes
+ * pixels into it row by row (bottom row first for bottomUp windows).
+ *
+ * Pixels are kept in wire order, big-endian RGB565, so the canvas can be sent
+ * to the display or written to a file with swap = false. A canvas made with
+ * canvas_wrap() may instead keep them in native order, like Adafruit GFX's
+ * GFXcanvas16 does.
+ */
+typedef struct {
+	uint16_t *pixels;       // width * height
+	uint16_t width, height;
+	bool native;            // pixels in native byte order
+	bool external;          // pixels not ours, see canvas_wrap()
+	ImgArea_t win;          // current window
+	int32_t x, y;           // write pointer inside the window
+	bool valid;             // window set and not full yet
+	bool drawn;             // area below is meaningful
+	ImgArea_t area;         // bounding box of every window prepared so far
+} ImgCanvas_t;
+
+/**
+ * @brief Allocate the canvas pixels.
+ * @param caps heap_caps_malloc() capabilities, e.g. MALLOC_CAP_SPIRAM.
+ */
+esp_err_t canvas_init(ImgCanvas_t *cv, uint16_t width, uint16_t height, uint32_t caps);
+void canvas_free(ImgCanvas_t *cv);
+
+/**
+ * @brief Use a framebuffer allocated elsewhere, e.g. GFXcanvas16::getBuffer().
+ *        canvas_free() leaves it alone.
+ * @param native pixels are native RGB565, not wire order
+ */
+void canvas_wrap(ImgCanvas_t *cv, uint16_t *pixels, uint16_t width, uint16_t height, bool native);
+
+// Forget the drawn area, the pixels are left as they are.
+void canvas_reset(ImgCanvas_t *cv);
+
+// Set every pixel to color (wire order) and forget the drawn area.
+void canvas_clear(ImgCanvas_t *cv, uint16_t color);
+
+esp_err_t canvas_prepare(ImgCanvas_t *cv, const ImgArea_t *area);
+void canvas_fill(ImgCanvas_t *cv, const uint16_t *data, uint32_t size, bool swap);
+
+/**
+ * @brief Build a sink that draws into the canvas.
+ *
+ * With next set every call is passed on to it as well, so a decode can be
+ * captured while it is shown. Sink callbacks carry no context, so only one
+ * canvas sink can be in use at a time.
+ * @param next sink to forward to, or NULL.
+ */
+void canvas_sink(ImgCanvas_t *cv, const ImgSink_t *next, ImgSink_t *sink);
+
+/**
+ * @brief Send the whole canvas to a sink in one window.
+ *
+ * The canvas may live in PSRAM, which SPI DMA can't read, so pixels are
+ * copied through PICDEC_READ_BLOCK sized bounce buffers from arena, double
+ * buffered when the sink has FillAsync.
+ */
+esp_err_t canvas_draw(const ImgCanvas_t *cv, const ImgSink_t *sink, ImgArena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IMG_CANVAS_H */
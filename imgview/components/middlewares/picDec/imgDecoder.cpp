@@ -1,9 +1,13 @@
 #include "string.h"
 #include "stdio.h"
+#include <sys/stat.h>
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 
 #include "imgDecoder.h"
 
+static const char *TAG = "IMG_DECODER";
+
 ImgSuffix_t ImgTypes[] = {
 		{".bmp", Img_BMP}, {".BMP", Img_BMP},
 		{".jpg", Img_JPG}, {".JPG", Img_JPG},
@@ -15,44 +19,118 @@ ImgSuffix_t ImgTypes[] = {
 imgDecoder::imgDecoder(pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen, LcdSize_t size)
 {
 	LcdSize = size;
-	pDrawInit = pDrawPrepare;
-	pFillData = pFillScreen;
+	sink.DrawPrepare = pDrawPrepare;
+	sink.FillScreen = pFillScreen;
+	sink.FillAsync = NULL;
+	sink.FillWait = NULL;
+	sink.FrameDelay = NULL;
+	flags = 0;
+	cacheDir = NULL;
+	memset(&pack, 0, sizeof(pack));
+	memset(&arena, 0, sizeof(arena));
 }
 
 imgDecoder::~imgDecoder()
 {
+	free(cacheDir);
+	pack_close(&pack);
+	arena_release(&arena);
+}
 
+void imgDecoder::setAsyncFill(pFillScreenAsync_t pFillAsync, pFillWait_t pFillWait)
+{
+	if(pFillAsync == NULL || pFillWait == NULL) {
+		pFillAsync = NULL;
+		pFillWait = NULL;
+	}
+	sink.FillAsync = pFillAsync;
+	sink.FillWait = pFillWait;
 }
 
-bool imgDecoder::strcmp(const char *p1, const char *p2)
+void imgDecoder::setCenter(bool enable)
 {
-	while((*p1 != 0) && (*p2 != 0)) {
-		if(*p1 != *p2) return false;
-		p1 ++; p2 ++;
+	if(enable) flags |= PICDEC_CENTER;
+	else flags &= ~PICDEC_CENTER;
+}
+
+void imgDecoder::setThumbnail(bool enable)
+{
+	if(enable) flags |= PICDEC_THUMB;
+	else flags &= ~PICDEC_THUMB;
+}
+
+void imgDecoder::setSplit(bool enable)
+{
+	if(enable) flags |= PICDEC_SPLIT;
+	else flags &= ~PICDEC_SPLIT;
+}
+
+void imgDecoder::setDither(bool enable)
+{
+	if(enable) flags |= PICDEC_DITHER;
+	else flags &= ~PICDEC_DITHER;
+}
+
+void imgDecoder::setFrameDelay(pFrameDelay_t pFrameDelay)
+{
+	sink.FrameDelay = pFrameDelay;
+}
+
+esp_err_t imgDecoder::reserve(uint32_t bytes)
+{
+	return arena_reserve(&arena, bytes);
+}
+
+ImgArena_t *imgDecoder::scratch()
+{
+	// Nothing outlives a decode, start each one with the whole arena.
+	arena_reset(&arena);
+	return &arena;
+}
+
+esp_err_t imgDecoder::setCache(const char *dir)
+{
+	struct stat st;
+	free(cacheDir);
+	cacheDir = NULL;
+	if(dir == NULL) return ESP_OK;
+	if(stat(dir, &st) != 0 && mkdir(dir, 0777) != 0) {
+		ESP_LOGE(TAG, "can't create cache directory %s", dir);
+		return ESP_FAIL;
 	}
-	if((*p1 != 0) || (*p2 != 0)) return false;
-	return true;
+	cacheDir = strdup(dir);
+	return (cacheDir != NULL) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t imgDecoder::setPack(const char *label)
+{
+	pack_close(&pack);
+	if(label == NULL) return ESP_OK;
+	return pack_open(&pack, label);
+}
+
+uint16_t imgDecoder::packCount()
+{
+	return pack_count(&pack);
+}
+
+const char *imgDecoder::packName(uint16_t index)
+{
+	const ImgPackEntry_t *entry = pack_entry(&pack, index);
+	return (entry != NULL) ? entry->name : NULL;
+}
+
+esp_err_t imgDecoder::decodePacked(const char *name)
+{
+	if(name == NULL) return ESP_ERR_INVALID_ARG;
+	const ImgPackEntry_t *entry = pack_find(&pack, name);
+	if(entry == NULL) return ESP_ERR_NOT_FOUND;
+	return pack_draw(&pack, entry, &sink, LcdSize, flags, scratch());
 }
 
 ImgType_t imgDecoder::checkType(const char *file)
 {
-	char *pointer = (char *)file + strlen(file);
-	int len = 5;
-	while(len --) {
-		if(*(-- pointer) == '.') break;
-	}
-	if(*pointer == '.') {
-		len = 0;
-		while(ImgTypes[len].type != Img_Unknow) {
-			if(strcmp(ImgTypes[len].suffix, pointer)) {
-				return ImgTypes[len].type;
-			}
-			len ++;
-		}
-		return Img_Unknow;
-	} else {
-		return Img_Unknow;
-	}
+	return img_type(file);
 }
 
 const char *imgDecoder::imgType2String(ImgType_t type)
@@ -70,12 +148,15 @@ esp_err_t imgDecoder::decode(const char *file)
 	switch(checkType(file)) {
 	case Img_BMP:
 		path = file;
+		if(cacheDir != NULL) return decodeCached(file, Img_BMP);
 		return decodeBMP(file);
 	case Img_JPG:
 		path = file;
+		if(cacheDir != NULL) return decodeCached(file, Img_JPG);
 		return decodeJPG(file);
 	case Img_GIF:
-		return ESP_ERR_NOT_SUPPORTED;
+		path = file;
+		return decodeGIF(file);
 	case Img_Unknow:
 	default:
 		return ESP_ERR_INVALID_ARG;
@@ -87,7 +168,7 @@ esp_err_t imgDecoder::decodeBMP(const char *file)
 	if(file == NULL) return ESP_ERR_INVALID_ARG;
 	if(checkType(file) != Img_BMP) return ESP_ERR_INVALID_ARG;
 	path = file;
-	return bmp_decode(path, pDrawInit, pFillData);
+	return bmp_decode(path, &sink, LcdSize, flags, scratch());
 }
 
 esp_err_t imgDecoder::decodeJPG(const char *file)
@@ -95,5 +176,60 @@ esp_err_t imgDecoder::decodeJPG(const char *file)
 	if(file == NULL) return ESP_ERR_INVALID_ARG;
 	if(checkType(file) != Img_JPG) return ESP_ERR_INVALID_ARG;
 	path = file;
-	return jpg_decode(path, pDrawInit, pFillData, LcdSize);
+	return jpg_decode(path, &sink, LcdSize, flags, scratch());
+}
+
+esp_err_t imgDecoder::decodeGIF(const char *file)
+{
+	if(file == NULL) return ESP_ERR_INVALID_ARG;
+	if(checkType(file) != Img_GIF) return ESP_ERR_INVALID_ARG;
+	path = file;
+	return gif_decode(path, &sink, LcdSize, flags, scratch());
+}
+
+esp_err_t imgDecoder::decodeRegion(const char *file, ImgArea_t src, uint16_t x, uint16_t y)
+{
+	if(file == NULL) return ESP_ERR_INVALID_ARG;
+	switch(checkType(file)) {
+	case Img_BMP:
+		path = file;
+		return bmp_decode_region(file, &sink, LcdSize, &src, x, y, scratch());
+	case Img_JPG:
+		path = file;
+		return jpg_decode_region(file, &sink, LcdSize, &src, x, y, scratch());
+	case Img_GIF:
+		return ESP_ERR_NOT_SUPPORTED;
+	case Img_Unknow:
+	default:
+		return ESP_ERR_INVALID_ARG;
+	}
+}
+
+esp_err_t imgDecoder::decodeCached(const char *file, ImgType_t type)
+{
+	char cpath[IMGCACHE_PATH_MAX];
+	ImgCacheKey_t key;
+	ImgCanvas_t canvas;
+	ImgSink_t capture;
+	esp_err_t ret;
+
+	// Splitting doesn't change what is drawn.
+	if(cache_key(&key, file, LcdSize, flags & ~PICDEC_SPLIT) != ESP_OK)
+		return (type == Img_BMP) ? decodeBMP(file) : decodeJPG(file);
+	cache_path(cpath, sizeof(cpath), cacheDir, file);
+	ret = cache_play(cpath, &key, &sink, scratch());
+	if(ret == ESP_OK) return ESP_OK;
+
+	// Miss: decode onto the display and a canvas, then keep the canvas.
+	if(canvas_init(&canvas, LcdSize.width, LcdSize.height, MALLOC_CAP_8BIT) != ESP_OK)
+		return (type == Img_BMP) ? decodeBMP(file) : decodeJPG(file);
+	canvas_sink(&canvas, &sink, &capture);
+	if(type == Img_BMP)
+		ret = bmp_decode(file, &capture, LcdSize, flags, scratch());
+	else
+		ret = jpg_decode(file, &capture, LcdSize, flags, scratch());
+	if(ret == ESP_OK)
+		cache_store(cpath, &key, &canvas);
+	canvas_free(&canvas);
+	return ret;
 }
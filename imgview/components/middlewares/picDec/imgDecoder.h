@@ -7,18 +7,16 @@
 
 #include "bmpDec.h"
 #include "jpgDec.h"
+#include "gifDec.h"
+#include "imgCache.h"
+#include "imgPack.h"
+#include "imgArena.h"
+#include "imgIndex.h"
+#include "imgTarget.h"
 
 #define LCD_WIDTH_DEFAULT      128
 #define LCD_HEIGHT_DEFAULT     160
 
-typedef enum {
-	Img_BMP = 0,
-	Img_JPG = 1,
-	Img_GIF = 2,
-
-	Img_Unknow = 0xF,
-} ImgType_t;
-
 typedef struct {
 	const char *suffix;
 	ImgType_t type;
@@ -30,17 +28,96 @@ class imgDecoder {
 private:
 	const char *path;
 	LcdSize_t LcdSize;
-	pDrawPrepare_t pDrawInit;
-	pFillScreen_t pFillData;
-	bool strcmp(const char *p1, const char *p2);
+	ImgSink_t sink;
+	uint8_t flags;
+	char *cacheDir;
+	ImgPack_t pack;
+	ImgArena_t arena;
+	ImgArena_t *scratch();
+	esp_err_t decodeCached(const char *file, ImgType_t type);
 public:
 	imgDecoder(pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen, LcdSize_t size = {LCD_WIDTH_DEFAULT, LCD_HEIGHT_DEFAULT});
 	virtual ~imgDecoder();
+	/**
+	 * @brief Enable double buffered output: decoders convert the next block
+	 *        while the previous one is pushed by DMA. Pass NULLs to disable.
+	 * @param pFillAsync queue pixels and return before they are sent
+	 * @param pFillWait wait until every queued fill is done
+	 */
+	void setAsyncFill(pFillScreenAsync_t pFillAsync, pFillWait_t pFillWait);
+	/**
+	 * @brief Center images smaller than the display instead of drawing them
+	 *        at the top left corner. The borders are left untouched.
+	 */
+	void setCenter(bool enable);
+	/**
+	 * @brief Let JPEGs be drawn from their EXIF thumbnail when it looks no
+	 *        smaller on the display than the scaled down image, which saves
+	 *        decoding the full camera image.
+	 */
+	void setThumbnail(bool enable);
+	/**
+	 * @brief Decode JPEGs that have restart intervals on both cores, each
+	 *        drawing its own stripes of the image. The sink callbacks are
+	 *        then called from a second task too, never concurrently.
+	 */
+	void setSplit(bool enable);
+	/**
+	 * @brief Quantize JPEGs to RGB565 with a 4x4 ordered dither instead of
+	 *        truncating, which breaks up the banding of smooth gradients.
+	 *        Costs a table lookup and an add per channel. Regions are drawn
+	 *        without it.
+	 */
+	void setDither(bool enable);
+	/**
+	 * @brief Set the callback that paces animated GIFs. It is called between
+	 *        frames with the delay of the frame on screen, NULL disables it.
+	 */
+	void setFrameDelay(pFrameDelay_t pFrameDelay);
+	/**
+	 * @brief Keep bytes of DMA capable memory for the decoders' work areas,
+	 *        read and line buffers, reused by every decode instead of being
+	 *        allocated and freed per image. Buffers that don't fit still come
+	 *        from the heap, see arenaStats(). 0 releases the memory.
+	 */
+	esp_err_t reserve(uint32_t bytes);
+	// Reserved size, high-water mark and heap fallbacks since reserve().
+	const ImgArena_t *arenaStats() const { return &arena; }
+	/**
+	 * @brief Keep decoded BMP and JPEG images in dir as display ready RGB565
+	 *        files. A cached image is streamed to the display without decoding
+	 *        as long as the source file's size and mtime, the display size and
+	 *        the decode flags are unchanged. Decoding a missing or stale entry
+	 *        draws through a display sized canvas and then writes the entry.
+	 *        GIFs are never cached. NULL disables the cache.
+	 * @param dir cache directory, created if missing
+	 */
+	esp_err_t setCache(const char *dir);
+	/**
+	 * @brief Open the image pack in a flash data partition, NULL closes it.
+	 *        Packed images are drawn without the SD card and without decoding.
+	 * @param label partition label, see imgPack.h for the format
+	 */
+	esp_err_t setPack(const char *label);
+	uint16_t packCount();
+	// Name of a packed image, NULL past the last one.
+	const char *packName(uint16_t index);
+	esp_err_t decodePacked(const char *name);
 	ImgType_t checkType(const char *file);
 	const char *imgType2String(ImgType_t type);
 	esp_err_t decode(const char *file);
 	esp_err_t decodeBMP(const char *file);
 	esp_err_t decodeJPG(const char *file);
+	esp_err_t decodeGIF(const char *file);
+	/**
+	 * @brief Draw part of a BMP or JPEG image at full size, for panning over
+	 *        images larger than the display. Only the rows (BMP) or MCUs
+	 *        (JPEG) the region needs are converted and sent.
+	 * @param src region in image pixels, clipped to the image
+	 * @param x, y display position of the region, which is clipped to the display
+	 * @return ESP_ERR_NOT_SUPPORTED for GIF files.
+	 */
+	esp_err_t decodeRegion(const char *file, ImgArea_t src, uint16_t x = 0, uint16_t y = 0);
 };
 
 #endif /* __cplusplus */
@@ -0,0 +1,235 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <dirent.h>
+#include "esp_log.h"
+#include "imgIndex.h"
+
+static const char *TAG = "IMG_INDEX";
+
+// Sanity limit for index files read back, a few thousand entries are ~100KB.
+#define IMGINDEX_SIZE_MAX       (1024 * 1024)
+#define IMGINDEX_MAX_ENTRIES    0xFFFF
+
+ImgType_t img_type(const char *file)
+{
+	const char *ext = strrchr(file, '.');
+	if(ext == NULL) return Img_Unknow;
+	ext ++;
+	if(strcasecmp(ext, "bmp") == 0) return Img_BMP;
+	if(strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0) return Img_JPG;
+	if(strcasecmp(ext, "gif") == 0) return Img_GIF;
+	return Img_Unknow;
+}
+
+// FNV-1a over the image names in readdir() order, NUL separated, then their count.
+static void index_sig_add(uint32_t *sig, const char *name)
+{
+	do {
+		*sig = (*sig ^ (uint8_t)*name) * 16777619u;
+	} while(*name ++ != 0);
+}
+
+static bool index_is_image(const struct dirent *de)
+{
+	return de->d_type == DT_REG && strlen(de->d_name) < 256 && img_type(de->d_name) != Img_Unknow;
+}
+
+static esp_err_t index_sig(const char *dir, uint32_t *sig)
+{
+	struct dirent *de;
+	uint32_t count = 0;
+
+	DIR *d = opendir(dir);
+	if(d == NULL) {
+		ESP_LOGE(TAG, "can't open %s", dir);
+		return ESP_FAIL;
+	}
+	*sig = 2166136261u;
+	while((de = readdir(d)) != NULL && count < IMGINDEX_MAX_ENTRIES) {
+		if(!index_is_image(de)) continue;
+		index_sig_add(sig, de->d_name);
+		count ++;
+	}
+	closedir(d);
+	*sig ^= count;
+	return ESP_OK;
+}
+
+static esp_err_t index_build(ImgIndex_t *idx, const char *dir)
+{
+	esp_err_t ret = ESP_OK;
+	ImgIndexEntry_t *entries = NULL;
+	char *names = NULL;
+	uint32_t sig = 2166136261u;
+	uint32_t count = 0, cap = 0, namesLen = 0, namesCap = 0;
+	struct dirent *de;
+
+	DIR *d = opendir(dir);
+	if(d == NULL) {
+		ESP_LOGE(TAG, "can't open %s", dir);
+		return ESP_FAIL;
+	}
+	while((de = readdir(d)) != NULL && count < IMGINDEX_MAX_ENTRIES) {
+		if(!index_is_image(de)) continue;
+		uint32_t len = strlen(de->d_name) + 1;
+		if(count == cap) {
+			cap = cap ? cap * 2 : 32;
+			void *p = realloc(entries, cap * sizeof(ImgIndexEntry_t));
+			if(p == NULL) {
+				ret = ESP_ERR_NO_MEM;
+				goto exit;
+			}
+			entries = (ImgIndexEntry_t *)p;
+		}
+		if(namesLen + len > namesCap) {
+			namesCap = namesCap ? namesCap * 2 : 512;
+			if(namesCap < namesLen + len) namesCap = namesLen + len;
+			void *p = realloc(names, namesCap);
+			if(p == NULL) {
+				ret = ESP_ERR_NO_MEM;
+				goto exit;
+			}
+			names = (char *)p;
+		}
+		ImgIndexEntry_t *e = &entries[count ++];
+		memset(e, 0, sizeof(ImgIndexEntry_t));
+		e->name = namesLen;
+		e->type = img_type(de->d_name);
+		memcpy(names + namesLen, de->d_name, len);
+		namesLen += len;
+		index_sig_add(&sig, de->d_name);
+	}
+
+	// One block, laid out like the file.
+	uint32_t base = sizeof(ImgIndexHeader_t) + count * sizeof(ImgIndexEntry_t);
+	idx->data = (uint8_t *)malloc(base + namesLen);
+	if(idx->data == NULL) {
+		ret = ESP_ERR_NO_MEM;
+		goto exit;
+	}
+	ImgIndexHeader_t *hdr = (ImgIndexHeader_t *)idx->data;
+	hdr->magic = IMGINDEX_MAGIC;
+	hdr->version = IMGINDEX_VERSION;
+	hdr->count = count;
+	hdr->size = base + namesLen;
+	hdr->dirSig = sig ^ count;
+	for(uint32_t i = 0; i < count; i ++)
+		entries[i].name += base;
+	if(count > 0) {
+		memcpy(idx->data + sizeof(ImgIndexHeader_t), entries, count * sizeof(ImgIndexEntry_t));
+		memcpy(idx->data + base, names, namesLen);
+	}
+	idx->hdr = hdr;
+	idx->entries = (const ImgIndexEntry_t *)(idx->data + sizeof(ImgIndexHeader_t));
+	ESP_LOGI(TAG, "%d images in %s", (int)count, dir);
+
+exit:
+	if(ret == ESP_ERR_NO_MEM)
+		ESP_LOGE(TAG, "Cannot allocate index of %s", dir);
+	closedir(d);
+	free(entries);
+	free(names);
+	return ret;
+}
+
+static esp_err_t index_read(ImgIndex_t *idx, const char *file, uint32_t sig)
+{
+	ImgIndexHeader_t hdr;
+	esp_err_t ret = ESP_FAIL;
+
+	FILE *f = fopen(file, "rb");
+	if(f == NULL)
+		return ESP_ERR_NOT_FOUND;
+	if(fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != IMGINDEX_MAGIC || hdr.version != IMGINDEX_VERSION
+			|| hdr.dirSig != sig || hdr.size > IMGINDEX_SIZE_MAX
+			|| hdr.size < sizeof(hdr) + (uint32_t)hdr.count * sizeof(ImgIndexEntry_t)) {
+		fclose(f);
+		return ESP_ERR_NOT_FOUND;
+	}
+	idx->data = (uint8_t *)malloc(hdr.size);
+	if(idx->data == NULL)
+		goto exit;
+	memcpy(idx->data, &hdr, sizeof(hdr));
+	if(fread(idx->data + sizeof(hdr), 1, hdr.size - sizeof(hdr), f) != hdr.size - sizeof(hdr))
+		goto exit;
+	idx->hdr = (const ImgIndexHeader_t *)idx->data;
+	idx->entries = (const ImgIndexEntry_t *)(idx->data + sizeof(hdr));
+	// Every name must lie in the name area and the last one must be terminated.
+	uint32_t base = sizeof(hdr) + (uint32_t)hdr.count * sizeof(ImgIndexEntry_t);
+	if(hdr.count > 0 && idx->data[hdr.size - 1] != 0)
+		goto exit;
+	for(uint16_t i = 0; i < hdr.count; i ++) {
+		if(idx->entries[i].name < base || idx->entries[i].name >= hdr.size)
+			goto exit;
+	}
+	ret = ESP_OK;
+
+exit:
+	fclose(f);
+	if(ret != ESP_OK) {
+		ESP_LOGE(TAG, "%s is corrupt", file);
+		index_free(idx);
+	}
+	return ret;
+}
+
+static esp_err_t index_write(const ImgIndex_t *idx, const char *file)
+{
+	ImgIndexHeader_t hdr = *idx->hdr;
+	bool ok;
+
+	FILE *f = fopen(file, "wb");
+	if(f == NULL) {
+		ESP_LOGE(TAG, "can't create %s", file);
+		return ESP_FAIL;
+	}
+	// Header without its magic first, it is only made valid once the rest is in.
+	hdr.magic = 0;
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+			&& fwrite(idx->data + sizeof(hdr), 1, hdr.size - sizeof(hdr), f) == hdr.size - sizeof(hdr);
+	hdr.magic = IMGINDEX_MAGIC;
+	if(ok && fflush(f) == 0 && fseek(f, 0, SEEK_SET) == 0)
+		ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+	else
+		ok = false;
+	if(fclose(f) != 0)
+		ok = false;
+	if(!ok) {
+		ESP_LOGE(TAG, "can't write %s", file);
+		remove(file);
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
+esp_err_t index_sync(ImgIndex_t *idx, const char *dir, const char *file)
+{
+	uint32_t sig;
+
+	if(index_sig(dir, &sig) != ESP_OK)
+		return ESP_FAIL;
+	if(idx->data != NULL && idx->hdr->dirSig == sig)
+		return ESP_OK;
+	index_free(idx);
+	if(index_read(idx, file, sig) == ESP_OK)
+		return ESP_OK;
+	esp_err_t ret = index_build(idx, dir);
+	if(ret != ESP_OK)
+		return ret;
+	index_write(idx, file);
+	return ESP_OK;
+}
+
+void index_free(ImgIndex_t *idx)
+{
+	free(idx->data);
+	memset(idx, 0, sizeof(ImgIndex_t));
+}
+
+const ImgIndexEntry_t *index_entry(const ImgIndex_t *idx, uint16_t i)
+{
+	if(i >= index_count(idx)) return NULL;
+	return &idx->entries[i];
+}
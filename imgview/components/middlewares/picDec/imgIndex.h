@@ -0,0 +1,82 @@
+#ifndef __IMG_INDEX_H
+#define __IMG_INDEX_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "ll_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Index of the images in a directory, so a slideshow walks an array instead
+ * of scanning the directory and opening every file on each pass.
+ *
+ *     ImgIndexHeader_t
+ *     ImgIndexEntry_t[count]
+ *     names, NUL terminated
+ *
+ * Entries are in readdir() order. The index is rebuilt when the images in
+ * the directory no longer match its signature, a hash of their count and
+ * names. The directory's mtime can't be used for this: FatFs doesn't update
+ * it when files are added to or removed from the directory.
+ */
+
+#define IMGINDEX_MAGIC          0x58444949      // "IIDX"
+#define IMGINDEX_VERSION        2
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;             // entries
+	uint32_t size;              // bytes, header to the end of the names
+	uint32_t dirSig;            // signature of the directory's images
+} __attribute__((packed)) ImgIndexHeader_t;
+
+typedef struct {
+	uint32_t name;              // offset of the file name from the start of the index
+	uint8_t type;               // ImgType_t
+	uint8_t reserved[3];
+} __attribute__((packed)) ImgIndexEntry_t;
+
+typedef struct {
+	uint8_t *data;              // the whole index, NULL if none
+	const ImgIndexHeader_t *hdr;
+	const ImgIndexEntry_t *entries;
+} ImgIndex_t;
+
+// Image type from the file name extension, case insensitive.
+ImgType_t img_type(const char *file);
+
+/**
+ * @brief Bring the index of dir up to date.
+ *
+ * Costs one pass of readdir() over dir, without opening any file, when the
+ * loaded index is current. Otherwise the index file is read, or rebuilt from
+ * the BMP, JPEG and GIF files in dir and written if it is missing or stale.
+ * @param file where the index is kept, best outside dir
+ * @return ESP_FAIL if dir can't be read. A failure to write the index file
+ *         is only logged.
+ */
+esp_err_t index_sync(ImgIndex_t *idx, const char *dir, const char *file);
+void index_free(ImgIndex_t *idx);
+
+static inline uint16_t index_count(const ImgIndex_t *idx)
+{
+	return (idx->data != NULL) ? idx->hdr->count : 0;
+}
+
+// Entry by position, NULL past the last one.
+const ImgIndexEntry_t *index_entry(const ImgIndex_t *idx, uint16_t i);
+
+static inline const char *index_name(const ImgIndex_t *idx, const ImgIndexEntry_t *entry)
+{
+	return (const char *)idx->data + entry->name;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IMG_INDEX_H */
@@ -0,0 +1,123 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "imgPack.h"
+
+static const char *TAG = "IMG_PACK";
+
+#define MMU_PAGE_SIZE          0x10000
+
+esp_err_t pack_open(ImgPack_t *pk, const char *label)
+{
+	ImgPackHeader_t hdr;
+	const void *ptr;
+
+	memset(pk, 0, sizeof(ImgPack_t));
+	pk->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+	if(pk->part == NULL) {
+		ESP_LOGE(TAG, "no partition %s", label);
+		return ESP_ERR_NOT_FOUND;
+	}
+	if(esp_partition_read(pk->part, 0, &hdr, sizeof(hdr)) != ESP_OK)
+		return ESP_FAIL;
+	if(hdr.magic != IMGPACK_MAGIC || hdr.version != IMGPACK_VERSION || hdr.size > pk->part->size
+			|| sizeof(hdr) + (uint32_t)hdr.count * sizeof(ImgPackEntry_t) > hdr.size) {
+		ESP_LOGE(TAG, "no image pack in partition %s", label);
+		return ESP_ERR_INVALID_STATE;
+	}
+	// Only map what the pack uses, MMU pages are 64KB.
+	uint32_t len = (hdr.size + MMU_PAGE_SIZE - 1) & ~(MMU_PAGE_SIZE - 1);
+	if(len > pk->part->size) len = pk->part->size;
+	if(esp_partition_mmap(pk->part, 0, len, SPI_FLASH_MMAP_DATA, &ptr, &pk->handle) != ESP_OK) {
+		ESP_LOGE(TAG, "can't map partition %s", label);
+		return ESP_FAIL;
+	}
+	pk->base = (const uint8_t *)ptr;
+	pk->hdr = (const ImgPackHeader_t *)ptr;
+	pk->entries = (const ImgPackEntry_t *)(pk->base + sizeof(ImgPackHeader_t));
+	ESP_LOGI(TAG, "%d images in %s", pk->hdr->count, label);
+	return ESP_OK;
+}
+
+void pack_close(ImgPack_t *pk)
+{
+	if(pk->base != NULL)
+		spi_flash_munmap(pk->handle);
+	memset(pk, 0, sizeof(ImgPack_t));
+}
+
+const ImgPackEntry_t *pack_entry(const ImgPack_t *pk, uint16_t index)
+{
+	if(index >= pack_count(pk)) return NULL;
+	return &pk->entries[index];
+}
+
+const ImgPackEntry_t *pack_find(const ImgPack_t *pk, const char *name)
+{
+	for(uint16_t i = 0; i < pack_count(pk); i ++) {
+		if(strncmp(pk->entries[i].name, name, IMGPACK_NAME_MAX) == 0)
+			return &pk->entries[i];
+	}
+	return NULL;
+}
+
+esp_err_t pack_draw(const ImgPack_t *pk, const ImgPackEntry_t *entry, const ImgSink_t *sink, LcdSize_t size, uint8_t flags,
+		ImgArena_t *arena)
+{
+	esp_err_t ret = ESP_OK;
+	uint16_t *buf[2] = {NULL, NULL};
+	int idx = 0;
+	uint16_t ox = 0, oy = 0;
+
+	if(pk->base == NULL || entry == NULL) return ESP_ERR_INVALID_ARG;
+	uint32_t pixels = (uint32_t)entry->width * entry->height;
+	if(pixels == 0 || entry->offset + (uint64_t)pixels * sizeof(uint16_t) > pk->hdr->size) {
+		ESP_LOGE(TAG, "bad entry %.*s", IMGPACK_NAME_MAX, entry->name);
+		return ESP_ERR_INVALID_STATE;
+	}
+	if(entry->width > size.width || entry->height > size.height) {
+		ESP_LOGE(TAG, "%.*s is larger than the display", IMGPACK_NAME_MAX, entry->name);
+		return ESP_ERR_INVALID_SIZE;
+	}
+	if(flags & PICDEC_CENTER) {
+		ox = (size.width - entry->width) / 2;
+		oy = (size.height - entry->height) / 2;
+	}
+
+	for(int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+		buf[i] = (uint16_t *)arena_alloc(arena, PICDEC_READ_BLOCK, MALLOC_CAP_DMA);
+		if(buf[i] == NULL) {
+			ESP_LOGE(TAG, "Cannot allocate bounce buffer");
+			ret = ESP_ERR_NO_MEM;
+			goto exit;
+		}
+	}
+	ImgArea_t area = {ox, ox + entry->width - 1, oy, oy + entry->height - 1, false};
+	if(sink->DrawPrepare(&area) != ESP_OK) {
+		ret = ESP_FAIL;
+		goto exit;
+	}
+
+	const uint16_t *src = (const uint16_t *)(pk->base + entry->offset);
+	while(pixels > 0) {
+		uint32_t n = PICDEC_READ_BLOCK / sizeof(uint16_t);
+		if(n > pixels) n = pixels;
+		memcpy(buf[idx], src, n * sizeof(uint16_t));
+		if(sink->FillAsync == NULL) {
+			sink->FillScreen(buf[idx], n, false);
+		} else {
+			sink->FillWait();
+			sink->FillAsync(buf[idx], n, false);
+			idx ^= 1;
+		}
+		src += n;
+		pixels -= n;
+	}
+
+exit:
+	if(sink->FillAsync != NULL)
+		sink->FillWait();
+	arena_free(arena, buf[1]);
+	arena_free(arena, buf[0]);
+	return ret;
+}
@@ -0,0 +1,88 @@
+#ifndef __IMG_PACK_H
+#define __IMG_PACK_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "ll_config.h"
+#include "imgArena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Image pack: display ready images in a flash data partition, built on the
+ * host by tools/imgpack.py.
+ *
+ *     ImgPackHeader_t
+ *     ImgPackEntry_t[count]
+ *     pixel blobs, 4 byte aligned
+ *
+ * All fields are little-endian. Each blob is width * height big-endian
+ * RGB565 pixels, top row first, ready to be sent with swap = false (or to
+ * CMyLcd::drawBitmapFromFlashPartition() at the entry's offset with
+ * swap_bytes_en = false).
+ */
+
+#define IMGPACK_MAGIC           0x4B415049      // "IPAK"
+#define IMGPACK_VERSION         1
+#define IMGPACK_NAME_MAX        24              // including the terminating NUL
+#define IMGPACK_SUBTYPE         0x40            // data partition subtype
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;             // entries
+	uint32_t size;              // bytes, header to the end of the last blob
+	uint32_t reserved;
+} __attribute__((packed)) ImgPackHeader_t;
+
+typedef struct {
+	char name[IMGPACK_NAME_MAX];
+	uint16_t width;
+	uint16_t height;
+	uint32_t offset;            // blob offset from the start of the pack
+} __attribute__((packed)) ImgPackEntry_t;
+
+typedef struct {
+	const esp_partition_t *part;
+	spi_flash_mmap_handle_t handle;
+	const uint8_t *base;        // mapped pack, NULL if not open
+	const ImgPackHeader_t *hdr;
+	const ImgPackEntry_t *entries;
+} ImgPack_t;
+
+/**
+ * @brief Find the pack partition by label and map it into the data address space.
+ * @return ESP_ERR_NOT_FOUND without such a partition, ESP_ERR_INVALID_STATE if
+ *         it doesn't hold a valid pack.
+ */
+esp_err_t pack_open(ImgPack_t *pk, const char *label);
+void pack_close(ImgPack_t *pk);
+
+static inline uint16_t pack_count(const ImgPack_t *pk)
+{
+	return (pk->base != NULL) ? pk->hdr->count : 0;
+}
+
+// Entry by index or by name, NULL if there is none.
+const ImgPackEntry_t *pack_entry(const ImgPack_t *pk, uint16_t index);
+const ImgPackEntry_t *pack_find(const ImgPack_t *pk, const char *name);
+
+/**
+ * @brief Draw an entry. The mapped flash is not DMA capable, so pixels are
+ *        copied through PICDEC_READ_BLOCK sized bounce buffers, double
+ *        buffered when the sink has FillAsync.
+ * @param flags PICDEC_CENTER to center the image on the display.
+ * @param arena where the bounce buffers come from, NULL to use the heap.
+ * @return ESP_ERR_INVALID_SIZE if the image is larger than the display.
+ */
+esp_err_t pack_draw(const ImgPack_t *pk, const ImgPackEntry_t *entry, const ImgSink_t *sink, LcdSize_t size, uint8_t flags,
+		ImgArena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IMG_PACK_H */
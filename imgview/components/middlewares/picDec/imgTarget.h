@@ -0,0 +1,66 @@
+#ifndef __IMG_TARGET_H
+#define __IMG_TARGET_H
+
+#include "imgCanvas.h"
+
+#ifdef __cplusplus
+
+/*
+ * Decode into memory instead of onto the display.
+ *
+ * imgTarget<N> supplies pDrawPrepare/pFillScreen callbacks that write into
+ * the canvas bound to it, honouring every window the decoders prepare (JPEG
+ * MCUs, bottom up BMPs, GIF frames), so the result is what the display would
+ * show:
+ *
+ *     GFXcanvas16 gfx(128, 160);
+ *     ImgCanvas_t cv;
+ *     canvas_wrap_gfx(&cv, gfx);
+ *     imgTarget<0>::bind(&cv);
+ *     imgDecoder dec(imgTarget<0>::DrawPrepare, imgTarget<0>::FillScreen, imgTarget<0>::size());
+ *
+ * Sink callbacks carry no context, each slot N is a separate set of them,
+ * so decoders drawing into different canvases at the same time need
+ * different slots. Rebinding a slot between decodes is fine.
+ */
+template <int N>
+class imgTarget {
+private:
+	static ImgCanvas_t *canvas;
+public:
+	static void bind(ImgCanvas_t *cv) { canvas = cv; }
+	static ImgCanvas_t *bound() { return canvas; }
+	// Size to construct the decoder with.
+	static LcdSize_t size()
+	{
+		LcdSize_t s = {canvas->width, canvas->height};
+		return s;
+	}
+	static esp_err_t DrawPrepare(ImgArea_t *area)
+	{
+		if(canvas == NULL) return ESP_ERR_INVALID_STATE;
+		return canvas_prepare(canvas, area);
+	}
+	static void FillScreen(const uint16_t *data, uint16_t size, bool swap)
+	{
+		if(canvas != NULL)
+			canvas_fill(canvas, data, size, swap);
+	}
+};
+
+template <int N> ImgCanvas_t *imgTarget<N>::canvas = NULL;
+
+/**
+ * @brief Wrap an Adafruit GFX GFXcanvas16 (or anything with getBuffer(),
+ *        width() and height() over native RGB565). Use it unrotated: width()
+ *        and height() follow the rotation, the buffer doesn't.
+ */
+template <class Canvas>
+inline void canvas_wrap_gfx(ImgCanvas_t *cv, Canvas &gfx)
+{
+	canvas_wrap(cv, gfx.getBuffer(), gfx.width(), gfx.height(), true);
+}
+
+#endif /* __cplusplus */
+
+#endif /* __IMG_TARGET_H */
@@ -23,97 +23,618 @@ format if you want to use a different image file.
 #include <stdio.h>
 #include <string.h>
 #include "jpgDec.h"
+#include "fileReader.h"
+#include "colorConv.h"
 #include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 const char *TAG = "JPEG_DEC";
 
 #define PIXEL_FIFO_SIZE        320
 
+//Band decoding, see jpg_split().
+#define JPG_SPLIT_MAX_INTERVALS 4096    //Restart interval table limit, 16KB.
+#define JPG_BAND_STACK          4096
+
+//Restart interval table of a jpeg, shared by the two bands decoding it.
+typedef struct {
+    uint32_t start;                 //SOI
+    uint32_t sosEnd;                //First byte of entropy coded data.
+    uint32_t sofPos;                //Frame height, the width follows.
+    uint16_t width, height;
+    uint8_t mw, mh;                 //MCU size in pixels.
+    uint16_t mpr;                   //MCUs per row.
+    uint32_t mcus;                  //MCUs in the image.
+    uint16_t nrst;                  //MCUs per restart interval.
+    uint32_t count;                 //Restart intervals.
+    uint32_t stripe;                //Intervals handed to a band at a time, about a MCU row.
+    uint32_t *ends;                 //Start of the RST marker (EOI for the last) ending each interval.
+    BYTE scale;
+    SemaphoreHandle_t lock;         //Serializes the sink.
+    SemaphoreHandle_t done;         //Given by the helper task when its band is finished.
+    volatile bool abort;            //A band failed, the other one stops too.
+} JpgSplit_t;
+
 //Data that is passed from the decoder function to the infunc/outfunc functions.
 typedef struct {
-    FILE *f;                        //Pointer to jpeg file stream.
-    int inPos;						//Current position in jpeg data
-    pDrawPrepare_t DrawPrepare;     //Initialize the displayer to draw pixel
-    pFillScreen_t FillPixel;        //pointer to a function to fill pixel data to displayer.
-    uint16_t *outFIFO;              //fifo to store rgb data.
-    int outPos;                     //Current position of rgb data;
+    FileReader_t rd;                //Forward reader over the jpeg file.
+    const ImgSink_t *sink;          //Displayer callbacks.
+    uint16_t *outFIFO[2];           //fifo to store rgb data, the second one is only used in async mode.
+    int outIdx;                     //fifo currently being filled.
+    int32_t ox, oy;                 //Position of the image on the display.
+    bool clip;                      //Region decoding, only MCUs overlapping roi are output.
+    bool dither;                    //Ordered dither instead of truncating to RGB565.
+    JRECT roi;                      //Region in image pixels, within the image and the display.
+    JpgSplit_t *split;              //Band decoding, the input is a band stream. NULL otherwise.
+    uint8_t band;                   //Stripes band, band + 2, band + 4... of the image.
+    BYTE sof[4];                    //Frame height and width of the band stream.
+    uint32_t count;                 //Restart intervals in the band.
+    uint32_t part, partPos;         //Band stream position: headers, then interval data and marker pairs.
+    uint32_t mcus, total;           //MCUs of the band output so far, and in all.
+    char *work;                     //Work area of the band's decoder.
+    JRESULT result;
 } JpegDev;
 
-//Input function for jpeg decoder. Just returns bytes from the inData field of the JpegDev structure.
-static UINT infunc(JDEC *decoder, BYTE *buf, UINT len) 
+static UINT band_read(JpegDev *jd, BYTE *buf, UINT len);
+
+//Input function for jpeg decoder. tjpgd only ever reads forward, so serve it from the
+//read-ahead block; skip requests (buf == NULL) just move the read position.
+static UINT infunc(JDEC *decoder, BYTE *buf, UINT len)
 {
-    //Read bytes from input file
     JpegDev *jd = (JpegDev*)decoder->device;
-    fseek(jd->f, jd->inPos, SEEK_SET);
-    if (buf != NULL)
-    	len = fread(buf, 1, len, jd->f);
-    jd->inPos += len;
-    return len;
+    if(jd->split != NULL) return band_read(jd, buf, len);
+    return reader_read(&jd->rd, buf, len);
+}
+
+//Both bands share the sink, a window and its pixels must go out together.
+static void band_lock(JpegDev *jd)
+{
+    if(jd->split != NULL) xSemaphoreTake(jd->split->lock, portMAX_DELAY);
+}
+
+static void band_unlock(JpegDev *jd)
+{
+    if(jd->split != NULL) xSemaphoreGive(jd->split->lock);
+}
+
+//Convert n pixels of the block drawn at area, from its pixel first on. Dithering goes a
+//row at a time since its threshold follows the display position.
+static void convert_block(const JpegDev *jd, uint16_t *out, const uint8_t *in, const ImgArea_t *area,
+                          int first, int n)
+{
+    int w = area->right - area->left + 1;
+
+    if(!jd->dither) {
+        rgb888_to_rgb565be(out, in, n);
+        return;
+    }
+    while(n > 0) {
+        int x = first % w, k = w - x;
+        if(k > n) k = n;
+        rgb888_to_rgb565be_dither(out, in, k, area->left + x, area->top + first / w);
+        out += k;
+        in += k * 3;
+        first += k;
+        n -= k;
+    }
+}
+
+//Double buffered output. The block is converted into the free fifo while the previous
+//one is still being pushed by DMA; only then we wait for the bus and move the window.
+static UINT outfunc_async(JpegDev *jd, uint8_t *in, ImgArea_t *area, int pixels)
+{
+    const ImgSink_t *sink = jd->sink;
+    uint16_t *fifo = jd->outFIFO[jd->outIdx];
+    convert_block(jd, fifo, in, area, 0, pixels);
+    band_lock(jd);
+    sink->FillWait();
+    if(sink->DrawPrepare(area) == ESP_OK) {
+        sink->FillAsync(fifo, pixels, false);
+        jd->outIdx ^= 1;
+    }
+    band_unlock(jd);
+    return 1;
+}
+
+//Cut the part of a MCU that lies inside the region out of its RGB888 block, in place.
+static void crop_block(uint8_t *in, const JRECT *rect, const JRECT *r)
+{
+    uint32_t w = (rect->right - rect->left + 1) * 3;
+    uint32_t cw = (r->right - r->left + 1) * 3;
+    const uint8_t *src = in + (r->top - rect->top) * w + (r->left - rect->left) * 3;
+    for(int y = r->top; y <= r->bottom; y ++) {
+        memmove(in, src, cw);
+        in += cw;
+        src += w;
+    }
+}
+
+//Intervals of a band's stream are those of every other stripe of the image.
+static uint32_t band_interval(const JpgSplit_t *sp, uint8_t band, uint32_t j)
+{
+    return ((j / sp->stripe) * 2 + band) * sp->stripe + j % sp->stripe;
+}
+
+//Move a MCU of the band stream to its place in the image, clipped to the image.
+//Returns false if nothing of it is inside.
+static bool band_place(JpegDev *jd, const JRECT *rect, JRECT *full, JRECT *r)
+{
+    const JpgSplit_t *sp = jd->split;
+    uint32_t mw = sp->mw >> sp->scale, mh = sp->mh >> sp->scale;
+    uint32_t m = (rect->top / mh) * sp->mpr + rect->left / mw;
+    uint32_t i = band_interval(sp, jd->band, m / sp->nrst) * sp->nrst + m % sp->nrst;
+    uint16_t w = sp->width >> sp->scale, h = sp->height >> sp->scale;
+
+    full->left = (i % sp->mpr) * mw;
+    full->top = (i / sp->mpr) * mh;
+    full->right = full->left + (rect->right - rect->left);
+    full->bottom = full->top + (rect->bottom - rect->top);
+    if(i >= sp->mcus || full->left >= w || full->top >= h) return false;
+    *r = *full;
+    if(r->right >= w) r->right = w - 1;
+    if(r->bottom >= h) r->bottom = h - 1;
+    return true;
 }
 
-//Output function. Re-encodes the RGB888 data from the decoder as big-endian RGB565 and
-//stores it in the outData array of the JpegDev structure.
+//Output function. Re-encodes the RGB888 data from the decoder as big-endian RGB565 in
+//one pass, so the fifo goes to the display without another byte swap.
 static UINT outfunc(JDEC *decoder, void *bitmap, JRECT *rect)
 {
     JpegDev *jd = (JpegDev *)decoder->device;
+    const ImgSink_t *sink = jd->sink;
     uint8_t *in = (uint8_t *)bitmap;
-    ImgArea_t area = {.left = rect->left, .right = rect->right, .top = rect->top, .bottom = rect->bottom};
-    if(jd->DrawPrepare(&area) == ESP_OK) {
-		for (int y = rect->top; y <= rect->bottom; y ++) {
-			for (int x = rect->left; x <= rect->right; x ++) {
-				//We need to convert the 3 bytes in `in` to a rgb565 value.
-				uint16_t v = 0;
-				v|=((in[0]>>3)<<11);
-				v|=((in[1]>>2)<<5);
-				v|=((in[2]>>3)<<0);
-				jd->outFIFO[jd->outPos ++] = v;
-				if(jd->outPos >= PIXEL_FIFO_SIZE) {
-					jd->FillPixel(jd->outFIFO, jd->outPos, true);
-					jd->outPos = 0;
-				}
-				in += 3;
-			}
-		}
-		if(jd->outPos > 0) {
-			jd->FillPixel(jd->outFIFO, jd->outPos, true);
-			jd->outPos = 0;
+    JRECT r = *rect, full;
+    UINT more = 1;
+
+    if(jd->split != NULL) {
+        //Stop right after the band's last MCU, its stream has no data past it.
+        if(jd->split->abort || jd->mcus >= jd->total) return 0;
+        more = (++ jd->mcus < jd->total);
+        if(!band_place(jd, rect, &full, &r)) return more;
+        if(r.right != full.right)
+            crop_block(in, &full, &r);
+    } else if(jd->clip) {
+        const JRECT *roi = &jd->roi;
+        //MCUs come in rows from the top: past the region's last row we are done.
+        if(rect->top > roi->bottom) return 0;
+        if(rect->bottom < roi->top || rect->right < roi->left || rect->left > roi->right) return 1;
+        r.left = (rect->left < roi->left) ? roi->left : rect->left;
+        r.right = (rect->right > roi->right) ? roi->right : rect->right;
+        r.top = (rect->top < roi->top) ? roi->top : rect->top;
+        r.bottom = (rect->bottom > roi->bottom) ? roi->bottom : rect->bottom;
+        if(r.left != rect->left || r.right != rect->right || r.top != rect->top)
+            crop_block(in, rect, &r);
+    }
+    ImgArea_t area = {.left = r.left + jd->ox, .right = r.right + jd->ox,
+                      .top = r.top + jd->oy, .bottom = r.bottom + jd->oy};
+    int pixels = (r.right - r.left + 1) * (r.bottom - r.top + 1);
+
+    if(sink->FillAsync != NULL) {
+        //A MCU is at most 16x16, so it always fits one fifo.
+        if(pixels <= PIXEL_FIFO_SIZE) return outfunc_async(jd, in, &area, pixels) && more;
+    }
+    band_lock(jd);
+    if(sink->FillAsync != NULL)
+        sink->FillWait();
+    if(sink->DrawPrepare(&area) == ESP_OK) {
+		for(int done = 0; done < pixels; ) {
+			int n = (pixels - done < PIXEL_FIFO_SIZE) ? pixels - done : PIXEL_FIFO_SIZE;
+			convert_block(jd, jd->outFIFO[0], in, &area, done, n);
+			sink->FillScreen(jd->outFIFO[0], n, false);
+			in += n * 3;
+			done += n;
 		}
     } else {
 // exit.
 //    	ESP_LOGW(TAG, "out of display area.");
     }
-    return 1;
+    band_unlock(jd);
+    return more;
 }
 
-static BYTE AutoScale(JDEC *dec, LcdSize_t *sz)
+static BYTE AutoScale(uint16_t width, uint16_t height, LcdSize_t *sz)
 {
 	BYTE scale = 0;
 	while(scale <= 3) {
-		if(((dec->width >> scale) <= sz->width) && ((dec->height >> scale) <= sz->height)) break;
+		if(((width >> scale) <= sz->width) && ((height >> scale) <= sz->height)) break;
 		scale ++;
 	}
 	return scale;
 }
 
+static int rd_byte(FileReader_t *rd)
+{
+    uint8_t b;
+    return (reader_read(rd, &b, 1) == 1) ? b : -1;
+}
+
+//Read a 16 or 32-bit value of the EXIF block, in its byte order.
+static uint32_t exif_get(const uint8_t *p, int n, bool be)
+{
+    uint32_t v = 0;
+    for(int i = 0; i < n; i ++)
+        v |= (uint32_t)p[be ? i : n - 1 - i] << (8 * (n - 1 - i));
+    return v;
+}
+
+//Find the thumbnail in an APP1 EXIF segment of len bytes at the read position:
+//IFD1, the second IFD of the TIFF structure, points at it with tags 0x201/0x202.
+static void exif_thumbnail(FileReader_t *rd, uint32_t len, JpgInfo_t *info)
+{
+    uint8_t b[12];
+    uint32_t tiff = reader_tell(rd) + 6;
+    uint32_t ifd, off = 0, size = 0;
+
+    if(len < 6 + 8 || reader_read(rd, b, 6) != 6 || memcmp(b, "Exif\0\0", 6) != 0) return;
+    len -= 6;
+    if(reader_read(rd, b, 8) != 8 || (b[0] != b[1]) || (b[0] != 'I' && b[0] != 'M')) return;
+    bool be = (b[0] == 'M');
+    ifd = exif_get(b + 4, 4, be);
+    //Skip IFD0 to get the offset of IFD1.
+    if(ifd > len - 2) return;
+    reader_seek(rd, tiff + ifd);
+    if(reader_read(rd, b, 2) != 2) return;
+    ifd += 2 + exif_get(b, 2, be) * 12;
+    if(ifd > len - 4) return;
+    reader_seek(rd, tiff + ifd);
+    if(reader_read(rd, b, 4) != 4 || (ifd = exif_get(b, 4, be)) == 0 || ifd > len - 2) return;
+    reader_seek(rd, tiff + ifd);
+    if(reader_read(rd, b, 2) != 2) return;
+    for(uint32_t n = exif_get(b, 2, be); n > 0 && reader_read(rd, b, 12) == 12; n --) {
+        uint16_t tag = exif_get(b, 2, be);
+        if(tag == 0x0201) off = exif_get(b + 8, 4, be);
+        else if(tag == 0x0202) size = exif_get(b + 8, 4, be);
+    }
+    if(off == 0 || size == 0 || off > len || size > len - off) return;
+    info->thumbOffset = tiff + off;
+    info->thumbSize = size;
+}
+
+//Walk the markers from the SOI at start up to the frame header. Only the file
+//reader's block is used, no decoder work area.
+static esp_err_t jpg_parse(FileReader_t *rd, uint32_t start, JpgInfo_t *info, bool exif)
+{
+    uint8_t b[6];
+    int c;
+
+    memset(info, 0, sizeof(JpgInfo_t));
+    reader_seek(rd, start);
+    if(reader_read(rd, b, 2) != 2 || b[0] != 0xFF || b[1] != 0xD8) return ESP_ERR_NOT_SUPPORTED;
+    for(;;) {
+        if(rd_byte(rd) != 0xFF) return ESP_ERR_NOT_SUPPORTED;
+        while((c = rd_byte(rd)) == 0xFF);
+        if(c < 0 || c == 0xD9 || c == 0xDA) return ESP_ERR_NOT_SUPPORTED;   //no frame header
+        if(c == 0x01 || (c >= 0xD0 && c <= 0xD8)) continue;                 //no length
+        if(reader_read(rd, b, 2) != 2) return ESP_ERR_NOT_SUPPORTED;
+        uint32_t len = (b[0] << 8) | b[1];
+        uint32_t next = reader_tell(rd) + len - 2;
+        if(len < 2) return ESP_ERR_NOT_SUPPORTED;
+        if(c >= 0xC0 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC) {
+            //SOFn: precision, height, width, components.
+            if(reader_read(rd, b, 6) != 6) return ESP_ERR_NOT_SUPPORTED;
+            info->height = (b[1] << 8) | b[2];
+            info->width = (b[3] << 8) | b[4];
+            info->baseline = (c == 0xC0);
+            return ESP_OK;
+        }
+        if(exif && c == 0xE1 && info->thumbSize == 0)
+            exif_thumbnail(rd, len - 2, info);
+        reader_seek(rd, next);
+    }
+}
+
+esp_err_t jpg_probe(const char *path, JpgInfo_t *info)
+{
+    FileReader_t rd;
+    //The headers sit at the start of the file, a sector at a time is enough.
+    esp_err_t ret = reader_open(&rd, path, 512, NULL);
+    if(ret != ESP_OK) return ret;
+    ret = jpg_parse(&rd, 0, info, true);
+    reader_close(&rd);
+    return ret;
+}
+
+//Start of the stream to decode: the EXIF thumbnail if it is allowed and shows at
+//least as much as the full image would at the scale the display needs, or if
+//the full image can't be decoded at all.
+static esp_err_t jpg_select(FileReader_t *rd, LcdSize_t *size, bool thumb, uint32_t *start)
+{
+    JpgInfo_t info, ti;
+    esp_err_t ret = jpg_parse(rd, 0, &info, thumb);
+    *start = 0;
+    if(ret != ESP_OK) return ret;
+    if(thumb && info.thumbSize > 0 && jpg_parse(rd, info.thumbOffset, &ti, false) == ESP_OK && ti.baseline) {
+        BYTE fs = AutoScale(info.width, info.height, size), ts = AutoScale(ti.width, ti.height, size);
+        if(ts <= 3 && (!info.baseline || fs > 3
+                || ((ti.width >> ts) >= (info.width >> fs) && (ti.height >> ts) >= (info.height >> fs)))) {
+            ESP_LOGI(TAG, "JPG %dx%d, using its %dx%d thumbnail", info.width, info.height, ti.width, ti.height);
+            *start = info.thumbOffset;
+            return ESP_OK;
+        }
+    }
+    if(!info.baseline) {
+        ESP_LOGE(TAG, "progressive or lossless jpeg, not supported");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
 //Size of the work space for the jpeg decoder.
 #define WORKSZ 3100
 
-//Decode the embedded image into pixel lines that can be used with the rest of the logic.
-esp_err_t jpg_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen, LcdSize_t size)
+//Find the restart intervals of the jpeg at start: frame and restart interval from the
+//headers, then every RST marker in the entropy coded data. Only baseline frames with
+//plain markers (no fill bytes) between the intervals are accepted.
+static esp_err_t split_scan(FileReader_t *rd, uint32_t start, JpgSplit_t *sp, ImgArena_t *arena)
+{
+    uint8_t b[8];
+    const uint8_t *p;
+    uint32_t len, n = 0, ffPos = 0;
+    bool ff = false;
+    int c;
+
+    reader_seek(rd, start);
+    sp->start = start;
+    if(reader_read(rd, b, 2) != 2 || b[0] != 0xFF || b[1] != 0xD8) return ESP_ERR_NOT_FOUND;
+    for(;;) {
+        if(rd_byte(rd) != 0xFF) return ESP_ERR_NOT_FOUND;
+        while((c = rd_byte(rd)) == 0xFF);
+        if(c < 0 || c == 0xD9) return ESP_ERR_NOT_FOUND;
+        if(c == 0x01 || (c >= 0xD0 && c <= 0xD8)) continue;
+        if(reader_read(rd, b, 2) != 2) return ESP_ERR_NOT_FOUND;
+        len = (b[0] << 8) | b[1];
+        if(len < 2) return ESP_ERR_NOT_FOUND;
+        uint32_t next = reader_tell(rd) + len - 2;
+        if(c == 0xDA) {
+            sp->sosEnd = next;
+            break;
+        }
+        if(c >= 0xC1 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC) return ESP_ERR_NOT_FOUND;
+        if(c == 0xC0) {
+            //Precision, height, width, components, then the first one's id and sampling.
+            if(reader_read(rd, b, 8) != 8) return ESP_ERR_NOT_FOUND;
+            sp->sofPos = reader_tell(rd) - 7;
+            sp->height = (b[1] << 8) | b[2];
+            sp->width = (b[3] << 8) | b[4];
+            sp->mw = (b[5] == 1) ? 8 : 8 * (b[7] >> 4);
+            sp->mh = (b[5] == 1) ? 8 : 8 * (b[7] & 0x0F);
+        } else if(c == 0xDD) {
+            if(reader_read(rd, b, 2) != 2) return ESP_ERR_NOT_FOUND;
+            sp->nrst = (b[0] << 8) | b[1];
+        }
+        reader_seek(rd, next);
+    }
+    if(sp->nrst == 0 || sp->width == 0 || sp->height == 0 || sp->mw == 0 || sp->mh == 0) return ESP_ERR_NOT_FOUND;
+    sp->mpr = (sp->width + sp->mw - 1) / sp->mw;
+    sp->mcus = (uint32_t)sp->mpr * ((sp->height + sp->mh - 1) / sp->mh);
+    sp->count = (sp->mcus + sp->nrst - 1) / sp->nrst;
+    sp->stripe = (sp->mpr + sp->nrst - 1) / sp->nrst;
+    //Both bands need at least a stripe, and the band streams' frames have to fit 16 bits.
+    if(sp->count <= sp->stripe || sp->count > JPG_SPLIT_MAX_INTERVALS || (uint32_t)sp->mpr * sp->mw > 0xFFFF)
+        return ESP_ERR_NOT_FOUND;
+    sp->ends = (uint32_t *)arena_alloc(arena, sp->count * sizeof(uint32_t), MALLOC_CAP_8BIT);
+    if(sp->ends == NULL) return ESP_ERR_NOT_FOUND;
+
+    reader_seek(rd, sp->sosEnd);
+    while(n < sp->count && (len = reader_peek(rd, &p)) > 0) {
+        uint32_t pos = reader_tell(rd);
+        for(uint32_t k = 0; k < len && n < sp->count; k ++) {
+            if(!ff) {
+                const uint8_t *q = (const uint8_t *)memchr(p + k, 0xFF, len - k);
+                if(q == NULL) break;
+                k = q - p;
+                ffPos = pos + k;
+                ff = true;
+                continue;
+            }
+            ff = false;
+            if(p[k] == 0x00) continue;                          //stuffed byte
+            if((p[k] & 0xF8) == 0xD0 && (p[k] & 7) == (n & 7) && n + 1 < sp->count)
+                sp->ends[n ++] = ffPos;
+            else if(p[k] == 0xD9 && n + 1 == sp->count)
+                sp->ends[n ++] = ffPos;
+            else
+                return ESP_ERR_NOT_FOUND;
+        }
+        reader_read(rd, NULL, len);
+    }
+    return (n == sp->count) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+//Input function of a band: the file's headers with the band's frame size patched in, then
+//the band's restart intervals, each followed by a RST marker numbered in band order, and
+//EOI after the last one. Parts alternate: 0 headers, odd ones data, even ones markers.
+static UINT band_read(JpegDev *jd, BYTE *buf, UINT len)
+{
+    const JpgSplit_t *sp = jd->split;
+    UINT done = 0;
+
+    while(done < len && jd->part <= 2 * jd->count) {
+        uint32_t from, size, n;
+        if(jd->part > 0 && !(jd->part & 1)) {
+            BYTE mark[2] = {0xFF, (jd->part == 2 * jd->count) ? 0xD9 : 0xD0 + ((jd->part / 2 - 1) & 7)};
+            n = 2 - jd->partPos;
+            if(n > len - done) n = len - done;
+            if(buf != NULL) memcpy(buf + done, mark + jd->partPos, n);
+            size = 2;
+        } else {
+            if(jd->part == 0) {
+                from = sp->start;
+                size = sp->sosEnd - from;
+            } else {
+                uint32_t i = band_interval(sp, jd->band, jd->part / 2);
+                from = (i == 0) ? sp->sosEnd : sp->ends[i - 1] + 2;
+                size = sp->ends[i] - from;
+            }
+            n = size - jd->partPos;
+            if(n > len - done) n = len - done;
+            from += jd->partPos;
+            reader_seek(&jd->rd, from);
+            n = reader_read(&jd->rd, (buf != NULL) ? buf + done : NULL, n);
+            if(n == 0) break;
+            for(int k = 0; k < 4 && jd->part == 0 && buf != NULL; k ++) {
+                if(sp->sofPos + k >= from && sp->sofPos + k < from + n)
+                    buf[done + sp->sofPos + k - from] = jd->sof[k];
+            }
+        }
+        done += n;
+        jd->partPos += n;
+        if(jd->partPos == size) {
+            jd->part ++;
+            jd->partPos = 0;
+        }
+    }
+    return done;
+}
+
+//Set up jd to decode band of the image: its intervals and the frame of its stream, the
+//image width rounded up to whole MCUs and as many MCU rows as its intervals need.
+static void band_setup(JpegDev *jd, JpgSplit_t *sp, uint8_t band)
+{
+    uint32_t i;
+
+    jd->split = sp;
+    jd->band = band;
+    jd->count = 0;
+    jd->total = 0;
+    while((i = band_interval(sp, band, jd->count)) < sp->count) {
+        jd->total += (sp->mcus - i * sp->nrst < sp->nrst) ? sp->mcus - i * sp->nrst : sp->nrst;
+        jd->count ++;
+    }
+    uint32_t w = (uint32_t)sp->mpr * sp->mw;
+    uint32_t h = (jd->count * sp->nrst + sp->mpr - 1) / sp->mpr * sp->mh;
+    jd->sof[0] = h >> 8;
+    jd->sof[1] = h;
+    jd->sof[2] = w >> 8;
+    jd->sof[3] = w;
+    jd->part = jd->partPos = 0;
+    jd->mcus = 0;
+    jd->outIdx = 0;
+}
+
+static void band_decode(JpegDev *jd)
+{
+    JDEC decoder;
+    JRESULT r = jd_prepare(&decoder, infunc, jd->work, WORKSZ, (void *)jd);
+    if(r == JDR_OK)
+        r = jd_decomp(&decoder, outfunc, jd->split->scale);
+    //outfunc interrupts the decode after the band's last MCU.
+    if(r == JDR_INTR && jd->mcus >= jd->total) r = JDR_OK;
+    if(r != JDR_OK) jd->split->abort = true;
+    jd->result = r;
+}
+
+static void band_task(void *arg)
+{
+    JpegDev *jd = (JpegDev *)arg;
+    band_decode(jd);
+    xSemaphoreGive(jd->split->done);
+    vTaskDelete(NULL);
+}
+
+//Decode the jpeg at start on both cores, if it has restart intervals: they are scanned
+//once, then each core decodes every other stripe of intervals from a stream of its own
+//that tjpgd takes for a smaller image, and outfunc moves its MCUs into place. jd is the
+//caller's band, set up with the reader, work area and fifos; the other band gets its own.
+//Returns ESP_ERR_NOT_FOUND if the image can't be split, nothing was drawn then.
+static esp_err_t jpg_split(JpegDev *jd, const char *path, LcdSize_t size, uint8_t flags, uint32_t start,
+                           ImgArena_t *arena)
+{
+    JpgSplit_t sp;
+    JpegDev helper;
+    esp_err_t ret;
+
+    if(portNUM_PROCESSORS < 2) return ESP_ERR_NOT_FOUND;
+    memset(&sp, 0, sizeof(sp));
+    memset(&helper, 0, sizeof(helper));
+    ret = split_scan(&jd->rd, start, &sp, arena);
+    if(ret != ESP_OK) goto exit;
+    //Too large to scale down: let the single core path report it.
+    sp.scale = AutoScale(sp.width, sp.height, &size);
+    if(sp.scale > 3) {
+        ret = ESP_ERR_NOT_FOUND;
+        goto exit;
+    }
+
+    ret = ESP_ERR_NOT_FOUND;
+    helper = *jd;
+    helper.outFIFO[0] = helper.outFIFO[1] = NULL;
+    helper.work = (char *)arena_calloc(arena, WORKSZ, MALLOC_CAP_8BIT);
+    if(helper.work == NULL || reader_open(&helper.rd, path, PICDEC_READ_BLOCK, arena) != ESP_OK) {
+        helper.rd.f = NULL;
+        goto exit;
+    }
+    for(int i = 0; i < ((jd->sink->FillAsync != NULL) ? 2 : 1); i ++) {
+        helper.outFIFO[i] = (uint16_t *)arena_alloc(arena, PIXEL_FIFO_SIZE * sizeof(uint16_t), MALLOC_CAP_DMA);
+        if(helper.outFIFO[i] == NULL) goto exit;
+    }
+    sp.lock = xSemaphoreCreateMutex();
+    sp.done = xSemaphoreCreateBinary();
+    if(sp.lock == NULL || sp.done == NULL) goto exit;
+
+    if(flags & PICDEC_CENTER) {
+        jd->ox = helper.ox = (size.width - (sp.width >> sp.scale)) / 2;
+        jd->oy = helper.oy = (size.height - (sp.height >> sp.scale)) / 2;
+    }
+    band_setup(jd, &sp, 0);
+    band_setup(&helper, &sp, 1);
+    if(xTaskCreatePinnedToCore(band_task, "jpgBand", JPG_BAND_STACK, &helper, uxTaskPriorityGet(NULL), NULL,
+                               xPortGetCoreID() ^ 1) != pdPASS)
+        goto exit;
+    ESP_LOGI(TAG, "JPG, size:%dx%d, %d restart intervals on two cores", sp.width, sp.height, (int)sp.count);
+    band_decode(jd);
+    xSemaphoreTake(sp.done, portMAX_DELAY);
+    ret = ESP_OK;
+    if(jd->result != JDR_OK || helper.result != JDR_OK) {
+        ESP_LOGE(TAG, "Image decoder: band decode failed (%d, %d)", jd->result, helper.result);
+        ret = ESP_ERR_NOT_SUPPORTED;
+    }
+
+exit:
+    //The helper's fifos may still be queued.
+    if(ret != ESP_ERR_NOT_FOUND && jd->sink->FillAsync != NULL)
+        jd->sink->FillWait();
+    if(sp.done != NULL) vSemaphoreDelete(sp.done);
+    if(sp.lock != NULL) vSemaphoreDelete(sp.lock);
+    for(int i = 1; i >= 0; i --)
+        arena_free(arena, helper.outFIFO[i]);
+    if(helper.rd.f != NULL) reader_close(&helper.rd);
+    arena_free(arena, helper.work);
+    arena_free(arena, sp.ends);
+    jd->split = NULL;
+    jd->outIdx = 0;
+    return ret;
+}
+
+//Decode the image, or the region roi of it to (dx, dy), into pixel lines that can be used
+//with the rest of the logic.
+static esp_err_t jpg_run(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags,
+                         const ImgArea_t *roi, uint16_t dx, uint16_t dy, ImgArena_t *arena)
 {
     char *work = NULL;
     int r;
     JDEC decoder;
     JpegDev jd;
     esp_err_t ret = ESP_OK;
-    FILE *f = fopen(path, "r"); // read only.
-    if(f == NULL) {
-    	ESP_LOGE(TAG, "can't open file %s", path);
-    	return ESP_FAIL;
+
+    jd.outFIFO[0] = jd.outFIFO[1] = NULL;
+    ret = reader_open(&jd.rd, path, PICDEC_READ_BLOCK, arena);
+    if(ret != ESP_OK) {
+    	return ret;
     }
+    //Headers first: unsupported files fail before anything is allocated.
+    uint32_t start;
+    ret = jpg_select(&jd.rd, &size, roi == NULL && (flags & PICDEC_THUMB), &start);
+    if(ret != ESP_OK) {
+        reader_close(&jd.rd);
+        return ret;
+    }
+    reader_seek(&jd.rd, start);
 
     //Allocate the work space for the jpeg decoder.
-    work = calloc(WORKSZ, 1);
+    work = arena_calloc(arena, WORKSZ, MALLOC_CAP_8BIT);
     if (work == NULL) {
         ESP_LOGE(TAG, "Cannot allocate workspace");
         ret = ESP_ERR_NO_MEM;
@@ -121,20 +642,31 @@ esp_err_t jpg_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_
     }
 
     //Populate fields of the JpegDev struct.
-    jd.f = f;
-    jd.DrawPrepare = pDrawPrepare;
-    jd.FillPixel = pFillScreen;
-    jd.inPos = 0;
-    jd.outFIFO = NULL;
-    jd.outPos = 0;
+    jd.sink = sink;
+    jd.outIdx = 0;
+    jd.ox = jd.oy = 0;
+    jd.clip = false;
+    jd.dither = (flags & PICDEC_DITHER) != 0;
+    jd.split = NULL;
+    jd.work = work;
 
     //Alocate pixel memory.
-	jd.outFIFO = (uint16_t *)heap_caps_malloc(PIXEL_FIFO_SIZE * sizeof(uint16_t), MALLOC_CAP_DMA);
-	if(jd.outFIFO == NULL) {
-		ESP_LOGE(TAG, "Cannot allocate rgb fifo");
-		ret = ESP_ERR_NO_MEM;
-		goto err;
-	}
+    for (int i = 0; i < ((sink->FillAsync != NULL) ? 2 : 1); i ++) {
+		jd.outFIFO[i] = (uint16_t *)arena_alloc(arena, PIXEL_FIFO_SIZE * sizeof(uint16_t), MALLOC_CAP_DMA);
+		if(jd.outFIFO[i] == NULL) {
+			ESP_LOGE(TAG, "Cannot allocate rgb fifo");
+			ret = ESP_ERR_NO_MEM;
+			goto err;
+		}
+    }
+
+    if(roi == NULL && (flags & PICDEC_SPLIT)) {
+        ret = jpg_split(&jd, path, size, flags, start, arena);
+        if(ret != ESP_ERR_NOT_FOUND) goto err;
+        //No restart intervals to split at, decode on this core.
+        ret = ESP_OK;
+        reader_seek(&jd.rd, start);
+    }
 
     //Prepare and decode the jpeg.
     r = jd_prepare(&decoder, infunc, work, WORKSZ, (void*)&jd);
@@ -144,14 +676,37 @@ esp_err_t jpg_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_
         goto err;
     }
     ESP_LOGI(TAG, "JPG, size:%dx%d", decoder.width, decoder.height);
-    BYTE scl = AutoScale(&decoder, &size);
-    if(scl > 3) {
+    BYTE scl = (roi == NULL) ? AutoScale(decoder.width, decoder.height, &size) : 0;
+    if(roi != NULL) {
+        //Region at full size, clipped to the image and the display.
+        if(roi->left > roi->right || roi->top > roi->bottom || roi->left >= decoder.width || roi->top >= decoder.height
+                || dx >= size.width || dy >= size.height) {
+            ESP_LOGE(TAG, "region outside the image");
+            ret = ESP_ERR_INVALID_ARG;
+            goto err;
+        }
+        jd.clip = true;
+        jd.roi.left = roi->left;
+        jd.roi.top = roi->top;
+        jd.roi.right = (roi->right < decoder.width) ? roi->right : decoder.width - 1;
+        jd.roi.bottom = (roi->bottom < decoder.height) ? roi->bottom : decoder.height - 1;
+        if(jd.roi.right - jd.roi.left >= size.width - dx) jd.roi.right = jd.roi.left + size.width - dx - 1;
+        if(jd.roi.bottom - jd.roi.top >= size.height - dy) jd.roi.bottom = jd.roi.top + size.height - dy - 1;
+        jd.ox = (int32_t)dx - jd.roi.left;
+        jd.oy = (int32_t)dy - jd.roi.top;
+    } else if(scl > 3) {
     	ESP_LOGE(TAG, "JPG file too large. <(1024x1024)");
 		ret = ESP_ERR_NOT_SUPPORTED;
 		goto err;
     }
+    if(roi == NULL && (flags & PICDEC_CENTER)) {
+    	jd.ox = (size.width - (decoder.width >> scl)) / 2;
+    	jd.oy = (size.height - (decoder.height >> scl)) / 2;
+    }
 
     r = jd_decomp(&decoder, outfunc, scl);
+    //outfunc interrupts the decode once it is past the region.
+    if (r == JDR_INTR && jd.clip) r = JDR_OK;
     if (r!=JDR_OK) {
         ESP_LOGE(TAG, "Image decoder: jd_decode failed (%d)", r);
         ret=ESP_ERR_NOT_SUPPORTED;
@@ -161,9 +716,23 @@ esp_err_t jpg_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_
     //All done! Free the work area (as we don't need it anymore) and return victoriously.
 err:
     //Something went wrong! Exit cleanly, de-allocating everything we allocated.
-	fclose(f);
-    free(work);
-    if(jd.outFIFO != NULL)
-    	heap_caps_free(jd.outFIFO);
+    //Queued fills still read from the fifos, let them drain first.
+    if(sink->FillAsync != NULL)
+    	sink->FillWait();
+    reader_close(&jd.rd);
+    arena_free(arena, work);
+    for (int i = 0; i < 2; i ++)
+    	arena_free(arena, jd.outFIFO[i]);
     return ret;
 }
+
+esp_err_t jpg_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena)
+{
+    return jpg_run(path, sink, size, flags, NULL, 0, 0, arena);
+}
+
+esp_err_t jpg_decode_region(const char *path, const ImgSink_t *sink, LcdSize_t size, const ImgArea_t *src, uint16_t x, uint16_t y,
+                            ImgArena_t *arena)
+{
+    return jpg_run(path, sink, size, 0, src, x, y, arena);
+}
@@ -2,21 +2,67 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "ll_config.h"
+#include "imgArena.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+    uint16_t width, height;
+    bool baseline;              //SOF0, the only frame type tjpgd decodes
+    uint32_t thumbOffset;       //EXIF thumbnail (a jpeg of its own) in the file
+    uint32_t thumbSize;         //0 if there is none
+} JpgInfo_t;
+
+/**
+ * @brief Read the frame size and type, and the location of the EXIF thumbnail,
+ *        without setting up the decoder. Only the markers before the frame
+ *        header are read.
+ * @return ESP_ERR_NOT_SUPPORTED if no frame header is found.
+ */
+esp_err_t jpg_probe(const char *path, JpgInfo_t *info);
+
 /**
- * @brief Decode the jpeg ``image.jpg`` embedded into the program file into pixel data.
+ * @brief Decode a baseline jpeg file onto the display.
+ * @param path file to decode
+ * @param sink display callbacks the pixels are drawn through
+ * @param size display size. Larger images are scaled down by 1/2, 1/4 or 1/8,
+ *        the smallest factor that makes them fit.
+ * @param flags PICDEC_CENTER, PICDEC_THUMB, PICDEC_SPLIT and PICDEC_DITHER, see below.
+ * @param arena scratch memory for the work area, pixel fifos and read buffer,
+ *        NULL to use the heap.
+ *
+ * With PICDEC_THUMB the EXIF thumbnail is decoded instead of the image
+ * when it comes out at least as large on the display, or when the image itself
+ * can't be decoded (progressive, or too large to scale down).
+ *
+ * With PICDEC_DITHER the pixels are quantized with a 4x4 ordered dither
+ * following their display position, see rgb888_to_rgb565be_dither().
+ *
+ * With PICDEC_SPLIT a jpeg with restart intervals (DRI) is decoded on both
+ * cores: the intervals are located in one pass over the file, then a task on
+ * the other core decodes every other stripe of them while the caller decodes
+ * the rest. Sink calls of the two are serialized. Other files are decoded on
+ * the calling core as usual.
  *
- * @param pixels A pointer to a pointer for an array of rows, which themselves are an array of pixels.
- *        Effectively, you can get the pixel data by doing ``decode_image(&myPixels); pixelval=myPixels[ypos][xpos];``
  * @return - ESP_ERR_NOT_SUPPORTED if image is malformed or a progressive jpeg file
  *         - ESP_ERR_NO_MEM if out of memory
  *         - ESP_OK on succesful decode
  */
-esp_err_t jpg_decode(const char *path, pDrawPrepare_t pDrawPrepare, pFillScreen_t pFillScreen, LcdSize_t size);
+esp_err_t jpg_decode(const char *path, const ImgSink_t *sink, LcdSize_t size, uint8_t flags, ImgArena_t *arena);
+
+/**
+ * @brief Decode part of a jpeg file at full size.
+ *
+ * MCUs outside the region are neither converted nor output, and decoding
+ * stops after the last MCU row that overlaps it. The entropy data before it
+ * still has to be decoded.
+ * @param src region in image pixels, clipped to the image
+ * @param x, y display position of the region, which is clipped to the display
+ */
+esp_err_t jpg_decode_region(const char *path, const ImgSink_t *sink, LcdSize_t size, const ImgArea_t *src, uint16_t x, uint16_t y,
+                            ImgArena_t *arena);
 
 #ifdef __cplusplus
 }
@@ -7,15 +7,55 @@
 
 #include "esp_system.h"
 
+// Read-ahead block used when streaming image files. Reads are issued at
+// multiples of this size, keep it a divisor of the FAT cluster size.
+#ifndef PICDEC_READ_BLOCK
+#define PICDEC_READ_BLOCK      4096
+#endif
+
 typedef struct {
 	uint16_t left, right, top, bottom;
+	bool bottomUp;      // pixels arrive bottom row first (BMP with positive height)
 } ImgArea_t;
 
 typedef struct {
 	uint16_t width, height;
 } LcdSize_t;
 
+typedef enum {
+	Img_BMP = 0,
+	Img_JPG = 1,
+	Img_GIF = 2,
+
+	Img_Unknow = 0xF,
+} ImgType_t;
+
+// Decode flags.
+#define PICDEC_CENTER          0x01    // center images smaller than the display
+#define PICDEC_THUMB           0x02    // allow JPEGs to be drawn from their EXIF thumbnail
+#define PICDEC_SPLIT           0x04    // decode JPEGs with restart intervals on both cores
+#define PICDEC_DITHER          0x08    // ordered dither JPEGs down to RGB565 instead of truncating
+
 typedef esp_err_t (*pDrawPrepare_t)(ImgArea_t *);
 typedef void (*pFillScreen_t)(const uint16_t *, uint16_t, bool);
 
+// Asynchronous variant of pFillScreen_t: queues the pixels and returns while
+// they are still being transferred. The buffer must be DMA capable and stay
+// untouched until pFillWait_t returns; with swap set it may be byte swapped
+// in place.
+typedef void (*pFillScreenAsync_t)(const uint16_t *, uint16_t, bool);
+// Blocks until every queued fill is done.
+typedef void (*pFillWait_t)(void);
+// Called between the frames of an animation with the time the frame just
+// drawn should stay on screen.
+typedef void (*pFrameDelay_t)(uint32_t ms);
+
+typedef struct {
+	pDrawPrepare_t DrawPrepare;
+	pFillScreen_t FillScreen;
+	pFillScreenAsync_t FillAsync;   // optional, enables double buffered output
+	pFillWait_t FillWait;           // required when FillAsync is set
+	pFrameDelay_t FrameDelay;       // optional, animations play without pauses if NULL
+} ImgSink_t;
+
 #endif /* __LL_CONFIG_H */
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <pthread.h>
+#include "host_trace.h"
+
+HostTrace_t host_trace;
+
+// Split JPEG decoding calls in from a second thread.
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+size_t __real_fread(void *ptr, size_t size, size_t n, FILE *f);
+int __real_fseek(FILE *f, long offset, int whence);
+
+void host_trace_reset(void)
+{
+	size_t cur = host_trace.heap_cur;
+	host_trace = (HostTrace_t){0};
+	host_trace.heap_cur = cur;
+	host_trace.heap_peak = cur;
+}
+
+static void heap_add(void *ptr)
+{
+	if(ptr == NULL) return;
+	pthread_mutex_lock(&trace_lock);
+	host_trace.allocs ++;
+	host_trace.heap_cur += malloc_usable_size(ptr);
+	if(host_trace.heap_cur > host_trace.heap_peak)
+		host_trace.heap_peak = host_trace.heap_cur;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+static void heap_sub(void *ptr)
+{
+	if(ptr == NULL) return;
+	pthread_mutex_lock(&trace_lock);
+	host_trace.heap_cur -= malloc_usable_size(ptr);
+	pthread_mutex_unlock(&trace_lock);
+}
+
+void *__wrap_malloc(size_t size)
+{
+	void *ptr = __real_malloc(size);
+	heap_add(ptr);
+	return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	void *ptr = __real_calloc(n, size);
+	heap_add(ptr);
+	return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	size_t old = (ptr != NULL) ? malloc_usable_size(ptr) : 0;
+	void *p = __real_realloc(ptr, size);
+	if(p == NULL) return NULL; // old block is still allocated.
+	pthread_mutex_lock(&trace_lock);
+	host_trace.heap_cur -= old;
+	pthread_mutex_unlock(&trace_lock);
+	heap_add(p);
+	return p;
+}
+
+void __wrap_free(void *ptr)
+{
+	heap_sub(ptr);
+	__real_free(ptr);
+}
+
+size_t __wrap_fread(void *ptr, size_t size, size_t n, FILE *f)
+{
+	size_t ret = __real_fread(ptr, size, n, f);
+	pthread_mutex_lock(&trace_lock);
+	host_trace.reads ++;
+	host_trace.bytes_read += ret * size;
+	pthread_mutex_unlock(&trace_lock);
+	return ret;
+}
+
+int __wrap_fseek(FILE *f, long offset, int whence)
+{
+	pthread_mutex_lock(&trace_lock);
+	host_trace.seeks ++;
+	pthread_mutex_unlock(&trace_lock);
+	return __real_fseek(f, offset, whence);
+}
@@ -0,0 +1,34 @@
+/* Allocation and file I/O accounting for host builds of picDec.
+ *
+ * The benchmark links with -Wl,--wrap for malloc/calloc/realloc/free and
+ * fread/fseek, so only calls made from the decoder objects are counted,
+ * not the ones libc makes internally. */
+#ifndef __HOST_TRACE_H
+#define __HOST_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	size_t heap_cur;        // bytes currently allocated by the decoders
+	size_t heap_peak;       // high-water mark of heap_cur since the last reset
+	uint32_t allocs;        // number of malloc/calloc/realloc calls
+	uint64_t bytes_read;    // bytes returned by fread
+	uint32_t reads;         // number of fread calls
+	uint32_t seeks;         // number of fseek calls
+} HostTrace_t;
+
+extern HostTrace_t host_trace;
+
+// Restart the counters; the peak restarts from the current heap usage.
+void host_trace_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_TRACE_H */
@@ -0,0 +1,438 @@
+/* picDec host benchmark.
+
+   Decodes every BMP/JPG given on the command line (files or directories)
+   through imgDecoder against a stub display, and reports per image:
+   decode time, bytes read from the file, peak decoder heap and a checksum
+   of the resulting screen contents.
+
+   The stub display behaves like the LCD's frame memory: pDrawPrepare sets
+   the address window and pFillScreen writes pixels into it row by row
+   (from the bottom row up for bottomUp windows, like the LCD with its row
+   order reversed), so the checksum only depends on what ends up on screen,
+   not on how the decoder chunks its output.
+
+   With -a the decoders run in double buffered mode. Async fills are only
+   recorded and written to frame memory when pFillWait is called, so a
+   decoder that reuses a buffer too early shows up as a wrong checksum, and
+   one that moves the window with fills still queued fails with
+   ESP_ERR_INVALID_STATE.
+
+   With -C the decoded image cache is enabled in the given directory: the
+   first run of each image decodes and writes its cache entry, the others
+   are served from it (compare min against a run without -C).
+
+   With -p every image of a pack built by tools/imgpack.py is drawn as well,
+   through the same partition mapping code the device uses.
+
+   With -r only a region of each BMP/JPG is decoded, the way a viewer
+   panning over a large image would.
+
+   With -d JPEGs are quantized with the ordered dither instead of being
+   truncated to RGB565; rgb565_bench has the per pixel cost of it.
+
+   With -2 JPEGs with restart intervals are decoded as two bands, one on a
+   second thread, the way the device splits them over both cores.
+
+   With -m the decoder draws into memory through imgTarget instead, over
+   the same frame memory (native RGB565 like a GFXcanvas16), so checksums
+   must match a run without -m. Pixels are not counted then.
+
+   With -w the screen after each image is written to dir as a binary PPM,
+   for comparing decoder output against golden images.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <algorithm>
+#include <vector>
+
+#include "imgDecoder.h"
+#include "host_trace.h"
+#include "esp_partition.h"
+
+#define SWAPBYTES(i) ((uint16_t)(((i) >> 8) | ((i) << 8)))
+
+#define PACK_LABEL   "imgpack"
+#define PACK_PREFIX  "pack:"
+
+typedef struct {
+	const uint16_t *data;
+	uint16_t size;
+	bool swap;
+} StubFill_t;
+
+typedef struct {
+	LcdSize_t size;
+	std::vector<uint16_t> fb;   // emulated frame memory, native RGB565
+	ImgArea_t win;              // current address window
+	int32_t x, y;               // write pointer inside the window
+	uint64_t pixels;            // pixels pushed through pFillScreen
+	uint32_t windows;           // pDrawPrepare calls accepted
+	uint32_t fills;             // pFillScreen calls
+	std::vector<StubFill_t> pending;    // queued async fills
+	uint32_t async_errors;      // windows moved or decode returned with fills pending
+	uint32_t frames;            // animation frames shown before the last one
+} StubLcd_t;
+
+static StubLcd_t lcd;
+
+static void stubFillScreen(const uint16_t *data, uint16_t size, bool swap);
+
+static void stubFillAsync(const uint16_t *data, uint16_t size, bool swap)
+{
+	StubFill_t fill = {data, size, swap};
+	lcd.pending.push_back(fill);
+}
+
+static void stubFillWait(void)
+{
+	for(size_t i = 0; i < lcd.pending.size(); i ++)
+		stubFillScreen(lcd.pending[i].data, lcd.pending[i].size, lcd.pending[i].swap);
+	lcd.pending.clear();
+}
+
+static void stubFrameDelay(uint32_t ms)
+{
+	// Frames are not paced, only counted.
+	lcd.frames ++;
+}
+
+static esp_err_t stubDrawPrepare(ImgArea_t *pRect)
+{
+	if((pRect->right + 1) > lcd.size.width) return ESP_FAIL;
+	if((pRect->bottom + 1) > lcd.size.height) return ESP_FAIL;
+	if(pRect->left > pRect->right || pRect->top > pRect->bottom) return ESP_FAIL;
+	if(!lcd.pending.empty()) {
+		lcd.async_errors ++;
+		stubFillWait();
+	}
+	lcd.win = *pRect;
+	lcd.x = pRect->left;
+	lcd.y = pRect->bottomUp ? pRect->bottom : pRect->top;
+	lcd.windows ++;
+	return ESP_OK;
+}
+
+static void stubFillScreen(const uint16_t *data, uint16_t size, bool swap)
+{
+	lcd.fills ++;
+	lcd.pixels += size;
+	while(size --) {
+		uint16_t v = *data ++;
+		// swap == false means the caller already produced display (big-endian) order.
+		if(!swap) v = SWAPBYTES(v);
+		// y leaves the window past its last row, bottom up it wraps below top.
+		if(lcd.y >= lcd.win.top && lcd.y <= lcd.win.bottom)
+			lcd.fb[lcd.y * lcd.size.width + lcd.x] = v;
+		if(++ lcd.x > lcd.win.right) {
+			lcd.x = lcd.win.left;
+			lcd.y += lcd.win.bottomUp ? -1 : 1;
+		}
+	}
+}
+
+static void stubReset(void)
+{
+	std::fill(lcd.fb.begin(), lcd.fb.end(), 0);
+	lcd.win = (ImgArea_t){0, 0, 0, 0, false};
+	lcd.x = lcd.y = 0;
+	lcd.pixels = 0;
+	lcd.windows = 0;
+	lcd.fills = 0;
+	lcd.pending.clear();
+	lcd.async_errors = 0;
+	lcd.frames = 0;
+}
+
+static uint32_t stubChecksum(void)
+{
+	// FNV-1a over the frame memory.
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < lcd.fb.size(); i ++) {
+		h = (h ^ (lcd.fb[i] & 0xFF)) * 16777619u;
+		h = (h ^ (lcd.fb[i] >> 8)) * 16777619u;
+	}
+	return h;
+}
+
+// Frame memory as a binary PPM, RGB565 widened to 8 bits per channel.
+static bool stubWritePpm(const char *dir, const char *name)
+{
+	std::string path = std::string(dir) + "/" + name + ".ppm";
+	FILE *f = fopen(path.c_str(), "wb");
+	if(f == NULL) return false;
+	fprintf(f, "P6\n%u %u\n255\n", lcd.size.width, lcd.size.height);
+	for(size_t i = 0; i < lcd.fb.size(); i ++) {
+		uint16_t v = lcd.fb[i];
+		uint8_t rgb[3] = {
+			(uint8_t)(((v >> 11) & 0x1F) * 255 / 31),
+			(uint8_t)(((v >> 5) & 0x3F) * 255 / 63),
+			(uint8_t)((v & 0x1F) * 255 / 31),
+		};
+		fwrite(rgb, 1, 3, f);
+	}
+	return fclose(f) == 0;
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void collect(imgDecoder *dec, const char *path, std::vector<std::string> &files)
+{
+	struct stat st;
+	if(stat(path, &st) != 0) {
+		fprintf(stderr, "can't stat %s\n", path);
+		return;
+	}
+	if(!S_ISDIR(st.st_mode)) {
+		files.push_back(path);
+		return;
+	}
+	DIR *dir = opendir(path);
+	if(dir == NULL) return;
+	std::vector<std::string> names;
+	struct dirent *de;
+	while((de = readdir(dir)) != NULL) {
+		if(de->d_name[0] == '.') continue;
+		std::string full = std::string(path) + "/" + de->d_name;
+		if(dec->checkType(full.c_str()) != Img_Unknow || (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode)))
+			names.push_back(full);
+	}
+	closedir(dir);
+	std::sort(names.begin(), names.end());
+	for(size_t i = 0; i < names.size(); i ++)
+		collect(dec, names[i].c_str(), files);
+}
+
+// The directory's images as the slideshow sees them: from an index file, in
+// readdir() order and not recursive.
+static bool collect_indexed(const char *path, const char *indexFile, std::vector<std::string> &files)
+{
+	ImgIndex_t idx;
+	memset(&idx, 0, sizeof(idx));
+	double t0 = now_ms();
+	if(index_sync(&idx, path, indexFile) != ESP_OK)
+		return false;
+	double t1 = now_ms();
+	// Again with the index in memory, as on every later pass.
+	index_sync(&idx, path, indexFile);
+	double t2 = now_ms();
+	for(uint16_t i = 0; i < index_count(&idx); i ++)
+		files.push_back(std::string(path) + "/" + index_name(&idx, index_entry(&idx, i)));
+	printf("index %s: %u image(s), sync %.3f ms, then %.3f ms\n", indexFile, index_count(&idx), t1 - t0, t2 - t1);
+	index_free(&idx);
+	return true;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"usage: %s [-n iterations] [-s WxH] [-a] [-c] [-t] [-d] [-2] [-C dir] [-p pack] [-r l,t,r,b[@x,y]] [-R bytes] [-I file] [-m] [-w dir] [image|dir]...\n"
+			"  -n  decode each image this many times (default 5)\n"
+			"  -s  stub display size (default %dx%d)\n"
+			"  -a  double buffered output through the async fill callbacks\n"
+			"  -c  center images on the display\n"
+			"  -t  draw JPEGs from their EXIF thumbnail when it is large enough\n"
+			"  -d  ordered dither JPEGs down to RGB565\n"
+			"  -2  decode JPEGs with restart intervals on two threads\n"
+			"  -C  cache decoded images in dir\n"
+			"  -p  also draw every image of an image pack file\n"
+			"  -r  decode only this region (image pixels) at display position x,y\n"
+			"  -R  reserve a decoder arena of this many bytes\n"
+			"  -I  list the (single) directory through an index kept in file\n"
+			"  -m  decode into memory through imgTarget instead of the stub display\n"
+			"  -w  write the screen after each image to dir as PPM\n",
+			prog, LCD_WIDTH_DEFAULT, LCD_HEIGHT_DEFAULT);
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 5;
+	bool async = false;
+	bool center = false;
+	bool thumb = false;
+	bool dither = false;
+	bool split = false;
+	const char *cache = NULL;
+	const char *packFile = NULL;
+	bool region = false;
+	ImgArea_t src = {0, 0, 0, 0, false};
+	unsigned rx = 0, ry = 0;
+	long arenaSize = 0;
+	const char *indexFile = NULL;
+	bool memory = false;
+	const char *ppmDir = NULL;
+	LcdSize_t size = {LCD_WIDTH_DEFAULT, LCD_HEIGHT_DEFAULT};
+	std::vector<const char *> inputs;
+
+	for(int i = 1; i < argc; i ++) {
+		if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+			iterations = atoi(argv[++ i]);
+		} else if(!strcmp(argv[i], "-s") && i + 1 < argc) {
+			unsigned w, h;
+			if(sscanf(argv[++ i], "%ux%u", &w, &h) != 2) {
+				usage(argv[0]);
+				return 2;
+			}
+			size.width = w;
+			size.height = h;
+		} else if(!strcmp(argv[i], "-a")) {
+			async = true;
+		} else if(!strcmp(argv[i], "-c")) {
+			center = true;
+		} else if(!strcmp(argv[i], "-t")) {
+			thumb = true;
+		} else if(!strcmp(argv[i], "-d")) {
+			dither = true;
+		} else if(!strcmp(argv[i], "-2")) {
+			split = true;
+		} else if(!strcmp(argv[i], "-C") && i + 1 < argc) {
+			cache = argv[++ i];
+		} else if(!strcmp(argv[i], "-p") && i + 1 < argc) {
+			packFile = argv[++ i];
+		} else if(!strcmp(argv[i], "-r") && i + 1 < argc) {
+			unsigned l, t, r, b;
+			int n = sscanf(argv[++ i], "%u,%u,%u,%u@%u,%u", &l, &t, &r, &b, &rx, &ry);
+			if(n != 4 && n != 6) {
+				usage(argv[0]);
+				return 2;
+			}
+			src.left = l;
+			src.top = t;
+			src.right = r;
+			src.bottom = b;
+			region = true;
+		} else if(!strcmp(argv[i], "-R") && i + 1 < argc) {
+			arenaSize = atol(argv[++ i]);
+		} else if(!strcmp(argv[i], "-I") && i + 1 < argc) {
+			indexFile = argv[++ i];
+		} else if(!strcmp(argv[i], "-m")) {
+			memory = true;
+		} else if(!strcmp(argv[i], "-w") && i + 1 < argc) {
+			ppmDir = argv[++ i];
+		} else if(argv[i][0] == '-') {
+			usage(argv[0]);
+			return 2;
+		} else {
+			inputs.push_back(argv[i]);
+		}
+	}
+	// The memory target has no async fills.
+	if((inputs.empty() && packFile == NULL) || iterations < 1 || (memory && async)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	lcd.size = size;
+	lcd.fb.resize(size.width * size.height);
+	ImgCanvas_t memCanvas;
+	canvas_wrap(&memCanvas, &lcd.fb[0], size.width, size.height, true);
+	imgTarget<0>::bind(&memCanvas);
+	imgDecoder *decoder = memory ? new imgDecoder(imgTarget<0>::DrawPrepare, imgTarget<0>::FillScreen, size)
+			: new imgDecoder(stubDrawPrepare, stubFillScreen, size);
+	if(async)
+		decoder->setAsyncFill(stubFillAsync, stubFillWait);
+	decoder->setCenter(center);
+	decoder->setThumbnail(thumb);
+	decoder->setSplit(split);
+	decoder->setDither(dither);
+	decoder->setFrameDelay(stubFrameDelay);
+	if(arenaSize > 0 && decoder->reserve(arenaSize) != ESP_OK) {
+		fprintf(stderr, "can't reserve %ld bytes\n", arenaSize);
+		return 2;
+	}
+	if(cache != NULL && decoder->setCache(cache) != ESP_OK) {
+		fprintf(stderr, "can't use cache directory %s\n", cache);
+		return 2;
+	}
+
+	std::vector<std::string> files;
+	if(indexFile != NULL) {
+		if(inputs.size() != 1 || !collect_indexed(inputs[0], indexFile, files)) {
+			fprintf(stderr, "can't index %s\n", inputs.empty() ? "nothing" : inputs[0]);
+			return 2;
+		}
+	} else {
+		for(size_t i = 0; i < inputs.size(); i ++)
+			collect(decoder, inputs[i], files);
+	}
+	if(packFile != NULL) {
+		if(host_partition_register(PACK_LABEL, packFile) != ESP_OK || decoder->setPack(PACK_LABEL) != ESP_OK) {
+			fprintf(stderr, "can't open image pack %s\n", packFile);
+			return 2;
+		}
+		for(uint16_t i = 0; i < decoder->packCount(); i ++)
+			files.push_back(std::string(PACK_PREFIX) + decoder->packName(i));
+	}
+
+	printf("%-32s %-5s %-8s %9s %9s %9s %6s %6s %8s %7s %9s %8s %6s\n",
+			"file", "type", "status", "min(ms)", "avg(ms)", "read(B)", "reads", "seeks",
+			"peak(B)", "allocs", "pixels", "crc", "frames");
+	int failed = 0;
+	double total_ms = 0;
+	for(size_t i = 0; i < files.size(); i ++) {
+		const char *file = files[i].c_str();
+		bool packed = !files[i].compare(0, strlen(PACK_PREFIX), PACK_PREFIX);
+		esp_err_t ret = ESP_OK;
+		double best = 0, sum = 0;
+		HostTrace_t trace = {0};
+		size_t heap_base = 0;
+		for(int n = 0; n < iterations; n ++) {
+			stubReset();
+			host_trace_reset();
+			if(n == 0) heap_base = host_trace.heap_cur;
+			double t0 = now_ms();
+			if(packed)
+				ret = decoder->decodePacked(file + strlen(PACK_PREFIX));
+			else if(region)
+				ret = decoder->decodeRegion(file, src, rx, ry);
+			else
+				ret = decoder->decode(file);
+			double t = now_ms() - t0;
+			if(!lcd.pending.empty()) {
+				lcd.async_errors ++;
+				stubFillWait();
+			}
+			if(ret == ESP_OK && lcd.async_errors)
+				ret = ESP_ERR_INVALID_STATE;
+			if(n == 0) {
+				// I/O and heap figures are deterministic, keep the first run's.
+				trace = host_trace;
+				best = t;
+			}
+			if(t < best) best = t;
+			sum += t;
+		}
+		const char *name = strrchr(file, '/');
+		name = (name != NULL) ? name + 1 : file;
+		if(packed) name = file + strlen(PACK_PREFIX);
+		ImgType_t type = decoder->checkType(file);
+		printf("%-32.32s %-5s %-8s %9.3f %9.3f %9llu %6u %6u %8zu %7u %9llu %08x %6u\n",
+				name, packed ? "pack" : (type == Img_Unknow ? "?" : decoder->imgType2String(type) + 1),
+				ret == ESP_OK ? "ok" : esp_err_to_name(ret),
+				best, sum / iterations,
+				(unsigned long long)trace.bytes_read, trace.reads, trace.seeks,
+				trace.heap_peak - heap_base, trace.allocs,
+				(unsigned long long)lcd.pixels, stubChecksum(), lcd.frames + 1);
+		if(ret != ESP_OK) failed ++;
+		if(ppmDir != NULL && !stubWritePpm(ppmDir, name))
+			fprintf(stderr, "can't write %s.ppm to %s\n", name, ppmDir);
+		total_ms += sum / iterations;
+	}
+	printf("%zu image(s), %d failed, %.3f ms total (avg per pass)\n", files.size(), failed, total_ms);
+	if(arenaSize > 0) {
+		const ImgArena_t *arena = decoder->arenaStats();
+		printf("arena %u bytes, peak %u, %u allocation(s) fell back to the heap\n",
+				(unsigned)arena->size, (unsigned)arena->peak, (unsigned)arena->misses);
+	}
+	delete decoder;
+	return failed ? 1 : 0;
+}
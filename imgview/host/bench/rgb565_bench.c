@@ -0,0 +1,202 @@
+/* RGB888 -> RGB565 conversion microbenchmark.
+
+   Compares the path the JPEG decoder used to take, a native RGB565
+   conversion followed by the LCD driver's SWAPBYTES copy before DMA, with
+   the single pass big-endian kernel in colorConv.c. Input is processed in
+   MCU sized blocks (16x16 pixels) like tjpgd hands them to outfunc, and
+   both paths must produce the same bytes.
+
+   The ordered dither kernel is timed over the same blocks, as 16 pixel
+   rows, and checked against a reference computing the thresholds from the
+   Bayer matrix.
+
+   Also times the packed two-pixel RGB565 blend of the slideshow transitions
+   against a channel by channel reference, over every alpha.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "colorConv.h"
+
+#define SWAPBYTES(i) ((uint16_t)(((i) >> 8) | ((i) << 8)))
+
+#define BLOCK_PIXELS    256
+
+static void convert_two_pass(uint16_t *out, uint16_t *tmp, const uint8_t *in, uint32_t n)
+{
+	// jpgDec outfunc
+	for(uint32_t i = 0; i < n; i ++) {
+		uint16_t v = 0;
+		v |= ((in[0] >> 3) << 11);
+		v |= ((in[1] >> 2) << 5);
+		v |= ((in[2] >> 3) << 0);
+		tmp[i] = v;
+		in += 3;
+	}
+	// lcd _fastSendBuf, swap = true
+	for(uint32_t i = 0; i < n; i ++)
+		out[i] = SWAPBYTES(tmp[i]);
+}
+
+static const uint8_t bayer4[4][4] = {
+	{ 0,  8,  2, 10},
+	{12,  4, 14,  6},
+	{ 3, 11,  1,  9},
+	{15,  7, 13,  5},
+};
+
+static uint32_t dither_channel(uint32_t c, uint32_t t, uint32_t bits)
+{
+	// A 16th of a quantization step per matrix level.
+	c += (t << (8 - bits)) >> 4;
+	return ((c > 255) ? 255 : c) >> (8 - bits);
+}
+
+static void dither_reference(uint16_t *out, const uint8_t *in, uint32_t n, uint32_t x, uint32_t y)
+{
+	for(uint32_t i = 0; i < n; i ++, x ++, in += 3) {
+		uint32_t t = bayer4[y & 3][x & 3];
+		uint16_t v = (dither_channel(in[0], t, 5) << 11) | (dither_channel(in[1], t, 6) << 5) | dither_channel(in[2], t, 5);
+		out[i] = SWAPBYTES(v);
+	}
+}
+
+// A block as 16 rows of 16 pixels, at the display position of MCU blk.
+static void dither_block(uint16_t *out, const uint8_t *in, uint32_t blk, int ref)
+{
+	uint32_t x0 = (blk % 8) * 16, y0 = (blk / 8) * 16;
+	for(uint32_t row = 0; row < 16; row ++) {
+		if(ref)
+			dither_reference(out + row * 16, in + row * 48, 16, x0, y0 + row);
+		else
+			rgb888_to_rgb565be_dither(out + row * 16, in + row * 48, 16, x0, y0 + row);
+	}
+}
+
+static void blend_reference(uint16_t *out, const uint16_t *a, const uint16_t *b, uint32_t n, uint32_t alpha)
+{
+	for(uint32_t i = 0; i < n; i ++) {
+		uint16_t pa = SWAPBYTES(a[i]), pb = SWAPBYTES(b[i]);
+		uint32_t r = (((pa >> 11) & 0x1F) * alpha + ((pb >> 11) & 0x1F) * (32 - alpha)) >> 5;
+		uint32_t g = (((pa >> 5) & 0x3F) * alpha + ((pb >> 5) & 0x3F) * (32 - alpha)) >> 5;
+		uint32_t bl = ((pa & 0x1F) * alpha + (pb & 0x1F) * (32 - alpha)) >> 5;
+		out[i] = SWAPBYTES((uint16_t)((r << 11) | (g << 5) | bl));
+	}
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t pixels = (argc > 1) ? strtoul(argv[1], NULL, 0) : 4u << 20;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 10;
+	pixels -= pixels % BLOCK_PIXELS;
+	if(pixels == 0 || rounds < 1) {
+		fprintf(stderr, "usage: %s [pixels] [rounds]\n", argv[0]);
+		return 2;
+	}
+
+	uint8_t *in = malloc(pixels * 3 + 1);
+	uint16_t *ref = malloc(pixels * sizeof(uint16_t));
+	uint16_t *out = malloc(pixels * sizeof(uint16_t) + 4);
+	uint16_t tmp[BLOCK_PIXELS];
+	if(in == NULL || ref == NULL || out == NULL) return 1;
+	uint32_t seed = 12345;
+	for(uint32_t i = 0; i < pixels * 3 + 1; i ++) {
+		seed = seed * 1103515245u + 12345u;
+		in[i] = seed >> 24;
+	}
+
+	double best_two = 1e30, best_one = 1e30, best_una = 1e30;
+	for(int r = 0; r < rounds; r ++) {
+		double t0 = now_ms();
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			convert_two_pass(ref + i, tmp, in + i * 3, BLOCK_PIXELS);
+		double t1 = now_ms();
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			rgb888_to_rgb565be(out + i, in + i * 3, BLOCK_PIXELS);
+		double t2 = now_ms();
+		if(memcmp(ref, out, pixels * sizeof(uint16_t)) != 0) {
+			fprintf(stderr, "aligned kernel mismatch\n");
+			return 1;
+		}
+		// Misaligned input takes the pixel by pixel fallback.
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			rgb888_to_rgb565be(out + i, in + 1 + i * 3, BLOCK_PIXELS);
+		double t3 = now_ms();
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			convert_two_pass(ref + i, tmp, in + 1 + i * 3, BLOCK_PIXELS);
+		if(memcmp(ref, out, pixels * sizeof(uint16_t)) != 0) {
+			fprintf(stderr, "scalar kernel mismatch\n");
+			return 1;
+		}
+		if(t1 - t0 < best_two) best_two = t1 - t0;
+		if(t2 - t1 < best_one) best_one = t2 - t1;
+		if(t3 - t2 < best_una) best_una = t3 - t2;
+	}
+
+	double best_dref = 1e30, best_dither = 1e30;
+	for(int r = 0; r < rounds; r ++) {
+		double t0 = now_ms();
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			dither_block(ref + i, in + i * 3, i / BLOCK_PIXELS, 1);
+		double t1 = now_ms();
+		for(uint32_t i = 0; i < pixels; i += BLOCK_PIXELS)
+			dither_block(out + i, in + i * 3, i / BLOCK_PIXELS, 0);
+		double t2 = now_ms();
+		if(memcmp(ref, out, pixels * sizeof(uint16_t)) != 0) {
+			fprintf(stderr, "dither kernel mismatch\n");
+			return 1;
+		}
+		if(t1 - t0 < best_dref) best_dref = t1 - t0;
+		if(t2 - t1 < best_dither) best_dither = t2 - t1;
+	}
+
+	// The same words as two RGB565 lines, blended at every alpha in turn.
+	uint16_t *la = (uint16_t *)in, *lb = la + pixels / 2;
+	uint32_t half = pixels / 2;
+	double best_ref = 1e30, best_blend = 1e30;
+	for(int r = 0; r < rounds; r ++) {
+		double t0 = now_ms();
+		for(uint32_t i = 0; i < half; i += BLOCK_PIXELS)
+			blend_reference(ref + i, la + i, lb + i, BLOCK_PIXELS, (i / BLOCK_PIXELS) % 33);
+		double t1 = now_ms();
+		for(uint32_t i = 0; i < half; i += BLOCK_PIXELS)
+			rgb565be_blend(out + i, la + i, lb + i, BLOCK_PIXELS, (i / BLOCK_PIXELS) % 33);
+		double t2 = now_ms();
+		if(memcmp(ref, out, half * sizeof(uint16_t)) != 0) {
+			fprintf(stderr, "blend kernel mismatch\n");
+			return 1;
+		}
+		// Odd length and misaligned output take the pixel by pixel tail.
+		rgb565be_blend(out + 1, la + 1, lb + 1, 255, 17);
+		blend_reference(ref + 1, la + 1, lb + 1, 255, 17);
+		if(memcmp(ref + 1, out + 1, 255 * sizeof(uint16_t)) != 0) {
+			fprintf(stderr, "scalar blend mismatch\n");
+			return 1;
+		}
+		if(t1 - t0 < best_ref) best_ref = t1 - t0;
+		if(t2 - t1 < best_blend) best_blend = t2 - t1;
+	}
+
+	printf("%-28s %10s %10s %8s\n", "path", "best(ms)", "ns/pixel", "speedup");
+	printf("%-28s %10.3f %10.3f %8.2f\n", "convert + swap (two pass)", best_two, best_two * 1e6 / pixels, 1.0);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "rgb888_to_rgb565be", best_one, best_one * 1e6 / pixels, best_two / best_one);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "rgb888_to_rgb565be (scalar)", best_una, best_una * 1e6 / pixels, best_two / best_una);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "dither, from the matrix", best_dref, best_dref * 1e6 / pixels, best_two / best_dref);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "rgb888_to_rgb565be_dither", best_dither, best_dither * 1e6 / pixels, best_two / best_dither);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "blend, per channel", best_ref, best_ref * 1e6 / half, 1.0);
+	printf("%-28s %10.3f %10.3f %8.2f\n", "rgb565be_blend", best_blend, best_blend * 1e6 / half, best_ref / best_blend);
+	free(in);
+	free(ref);
+	free(out);
+	return 0;
+}
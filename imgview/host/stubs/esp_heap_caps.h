@@ -0,0 +1,22 @@
+/* Host stand-in for the ESP-IDF esp_heap_caps.h.
+ * Capabilities are ignored; everything comes from the libc heap so the
+ * benchmark's allocation accounting sees it. */
+#ifndef __HOST_ESP_HEAP_CAPS_H
+#define __HOST_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_EXEC             (1<<0)
+#define MALLOC_CAP_32BIT            (1<<1)
+#define MALLOC_CAP_8BIT             (1<<2)
+#define MALLOC_CAP_DMA              (1<<3)
+#define MALLOC_CAP_SPIRAM           (1<<10)
+#define MALLOC_CAP_INTERNAL         (1<<11)
+#define MALLOC_CAP_DEFAULT          (1<<12)
+
+#define heap_caps_malloc(size, caps)           malloc(size)
+#define heap_caps_calloc(n, size, caps)        calloc(n, size)
+#define heap_caps_realloc(ptr, size, caps)     realloc(ptr, size)
+#define heap_caps_free(ptr)                    free(ptr)
+
+#endif /* __HOST_ESP_HEAP_CAPS_H */
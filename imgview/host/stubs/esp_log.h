@@ -0,0 +1,21 @@
+/* Host stand-in for the ESP-IDF esp_log.h.
+ * Errors and warnings go to stderr, info and below are dropped unless
+ * HOST_LOG_VERBOSE is defined, so benchmark output stays readable. */
+#ifndef __HOST_ESP_LOG_H
+#define __HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, fmt, ...)   fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)   fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+
+#ifdef HOST_LOG_VERBOSE
+#define ESP_LOGI(tag, fmt, ...)   fprintf(stderr, "I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)   fprintf(stderr, "D (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define ESP_LOGI(tag, fmt, ...)   do { (void)(tag); } while(0)
+#define ESP_LOGD(tag, fmt, ...)   do { (void)(tag); } while(0)
+#endif
+#define ESP_LOGV(tag, fmt, ...)   do { (void)(tag); } while(0)
+
+#endif /* __HOST_ESP_LOG_H */
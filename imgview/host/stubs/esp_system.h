@@ -0,0 +1,11 @@
+/* Host stand-in for the ESP-IDF esp_system.h. */
+#ifndef __HOST_ESP_SYSTEM_H
+#define __HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "esp_err.h"
+
+#endif /* __HOST_ESP_SYSTEM_H */
@@ -0,0 +1,26 @@
+/* Host stand-in for the ESP-IDF freertos/FreeRTOS.h.
+ * Tasks are POSIX threads, core affinity is ignored. Only what picDec uses. */
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define portNUM_PROCESSORS      2
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_FREERTOS_H */
@@ -0,0 +1,104 @@
+/* FreeRTOS tasks and semaphores on POSIX threads, for the host build. */
+#include <stdlib.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// Mutexes and binary semaphores alike: a count of 0 or 1 under a lock.
+struct HostSemaphore {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int count;
+};
+
+typedef struct {
+	TaskFunction_t task;
+	void *arg;
+} HostTask_t;
+
+static void *task_main(void *p)
+{
+	HostTask_t t = *(HostTask_t *)p;
+	free(p);
+	t.task(t.arg);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stack, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+	pthread_t th;
+	HostTask_t *t = (HostTask_t *)malloc(sizeof(HostTask_t));
+	if(t == NULL) return pdFALSE;
+	t->task = task;
+	t->arg = arg;
+	if(pthread_create(&th, NULL, task_main, t) != 0) {
+		free(t);
+		return pdFALSE;
+	}
+	pthread_detach(th);
+	if(handle != NULL) *handle = NULL;
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	pthread_exit(NULL);
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+	return 1;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+	return 0;
+}
+
+static SemaphoreHandle_t sem_create(int count)
+{
+	SemaphoreHandle_t s = (SemaphoreHandle_t)malloc(sizeof(struct HostSemaphore));
+	if(s == NULL) return NULL;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+	s->count = count;
+	return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	return sem_create(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return sem_create(0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks)
+{
+	pthread_mutex_lock(&s->lock);
+	while(s->count == 0)
+		pthread_cond_wait(&s->cond, &s->lock);
+	s->count = 0;
+	pthread_mutex_unlock(&s->lock);
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s)
+{
+	pthread_mutex_lock(&s->lock);
+	s->count = 1;
+	pthread_cond_signal(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+	return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t s)
+{
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->lock);
+	free(s);
+}
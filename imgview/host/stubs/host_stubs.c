@@ -0,0 +1,83 @@
+/* Host implementations of the few ESP-IDF helpers picDec calls. */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	switch(code) {
+	case ESP_OK:                return "ESP_OK";
+	case ESP_FAIL:              return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+	case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+	case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+	case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+	case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+	case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+	default:                    return "UNKNOWN ERROR";
+	}
+}
+
+// One file backed partition is enough for the bench. Mapping goes through
+// mmap(2) so it doesn't show up in the decoder heap accounting.
+static esp_partition_t host_part;
+static int host_part_fd = -1;
+static void *host_map;
+static size_t host_map_len;
+
+esp_err_t host_partition_register(const char *label, const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0) return ESP_ERR_NOT_FOUND;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		return ESP_FAIL;
+	}
+	if(host_part_fd >= 0) close(host_part_fd);
+	host_part_fd = fd;
+	memset(&host_part, 0, sizeof(host_part));
+	host_part.type = ESP_PARTITION_TYPE_DATA;
+	host_part.subtype = ESP_PARTITION_SUBTYPE_ANY;
+	host_part.size = st.st_size;
+	snprintf(host_part.label, sizeof(host_part.label), "%s", label);
+	return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	if(host_part_fd < 0 || type != host_part.type) return NULL;
+	if(label != NULL && strcmp(label, host_part.label) != 0) return NULL;
+	return &host_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+	if(partition != &host_part || src_offset + size > host_part.size) return ESP_ERR_INVALID_SIZE;
+	return (pread(host_part_fd, dst, size, src_offset) == (ssize_t)size) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, uint32_t offset, uint32_t size,
+		spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle)
+{
+	if(partition != &host_part || offset + size > host_part.size || host_map != NULL) return ESP_ERR_INVALID_ARG;
+	void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, host_part_fd, offset);
+	if(p == MAP_FAILED) return ESP_FAIL;
+	host_map = p;
+	host_map_len = size;
+	*out_ptr = p;
+	*out_handle = 1;
+	return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+	if(host_map != NULL) munmap(host_map, host_map_len);
+	host_map = NULL;
+}
@@ -0,0 +1,21 @@
+/* Placeholder for the ROM JPEG decoder when no TJpgDec sources are given.
+   Every stream is reported as an unsupported JPEG standard, so JPEG entries
+   in a benchmark run show up as failed instead of breaking the build. */
+#include <string.h>
+#include "rom/tjpgd.h"
+
+JRESULT jd_prepare(JDEC *jd, UINT (*infunc)(JDEC*, BYTE*, UINT), void *pool, UINT sz_pool, void *dev)
+{
+	memset(jd, 0, sizeof(JDEC));
+	jd->pool = pool;
+	jd->sz_pool = sz_pool;
+	jd->infunc = infunc;
+	jd->device = dev;
+	return JDR_FMT3;
+}
+
+JRESULT jd_decomp(JDEC *jd, UINT (*outfunc)(JDEC*, void*, JRECT*), BYTE scale)
+{
+	(void)jd; (void)outfunc; (void)scale;
+	return JDR_FMT3;
+}
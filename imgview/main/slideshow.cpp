@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "slideshow.h"
+
+static const char *TAG = "Slideshow";
+
+#define SLIDESHOW_STACK   6144
+
+static imgDecoder *decoder = NULL;
+static Slide_t slides[SLIDE_COUNT];
+static QueueHandle_t freeQ = NULL;      // slides the producer may fill
+static QueueHandle_t readyQ = NULL;     // slides waiting to be shown
+static const char *slideDir;
+static const char *slideIndexFile;
+static ImgIndex_t slideIndex;           // producer only
+static LcdSize_t slideSize;
+static uint16_t slideBackground;        // wire order
+
+// The producer decoder draws into the slide being prefetched.
+typedef imgTarget<1> BackTarget;
+
+imgDecoder *slideshow_decoder(LcdSize_t size)
+{
+	if(decoder == NULL) {
+		decoder = new imgDecoder(BackTarget::DrawPrepare, BackTarget::FillScreen, size);
+		slideSize = size;
+	}
+	return decoder;
+}
+
+void slideshow_decoder_free(void)
+{
+	if(freeQ != NULL) return;
+	delete decoder;
+	decoder = NULL;
+}
+
+static void slideshow_task(void *arg)
+{
+	Slide_t *slide;
+
+	while(1) {
+		// Only a readdir() pass unless images were added, removed or renamed.
+		index_sync(&slideIndex, slideDir, slideIndexFile);
+		for(uint16_t i = 0; i < index_count(&slideIndex); i ++) {
+			const ImgIndexEntry_t *entry = index_entry(&slideIndex, i);
+			xQueueReceive(freeQ, &slide, portMAX_DELAY);
+			snprintf(slide->path, sizeof(slide->path), "%s/%s", slideDir, index_name(&slideIndex, entry));
+			slide->name = slide->path + strlen(slideDir) + 1;
+			slide->live = (entry->type == Img_GIF);
+			slide->ret = ESP_OK;
+			if(!slide->live) {
+				canvas_clear(&slide->canvas, slideBackground);
+				BackTarget::bind(&slide->canvas);
+				slide->ret = decoder->decode(slide->path);
+			}
+			xQueueSend(readyQ, &slide, portMAX_DELAY);
+		}
+
+		xQueueReceive(freeQ, &slide, portMAX_DELAY);
+		slide->path[0] = 0;
+		slide->name = slide->path;
+		slide->live = false;
+		xQueueSend(readyQ, &slide, portMAX_DELAY);
+	}
+}
+
+esp_err_t slideshow_start(const char *dir, const char *index, uint16_t background, int core)
+{
+	if(decoder == NULL || freeQ != NULL) return ESP_ERR_INVALID_STATE;
+	// SPI DMA can't read PSRAM, but slides are sent through bounce buffers anyway.
+	uint32_t caps = (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) > 0) ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT;
+	if(caps != MALLOC_CAP_SPIRAM)
+		ESP_LOGI(TAG, "no PSRAM, slides in internal RAM");
+	for(int i = 0; i < SLIDE_COUNT; i ++) {
+		if(canvas_init(&slides[i].canvas, slideSize.width, slideSize.height, caps) != ESP_OK)
+			goto err;
+	}
+	freeQ = xQueueCreate(SLIDE_COUNT, sizeof(Slide_t *));
+	readyQ = xQueueCreate(SLIDE_COUNT, sizeof(Slide_t *));
+	if(freeQ == NULL || readyQ == NULL)
+		goto err;
+	for(int i = 0; i < SLIDE_COUNT; i ++) {
+		Slide_t *slide = &slides[i];
+		xQueueSend(freeQ, &slide, 0);
+	}
+
+	slideDir = dir;
+	slideIndexFile = index;
+	slideBackground = (background >> 8) | (background << 8);
+	if(xTaskCreatePinnedToCore(slideshow_task, "slideshow", SLIDESHOW_STACK, NULL, 1, NULL, core) != pdPASS)
+		goto err;
+	return ESP_OK;
+
+err:
+	ESP_LOGE(TAG, "can't start the slideshow");
+	if(freeQ != NULL) vQueueDelete(freeQ);
+	if(readyQ != NULL) vQueueDelete(readyQ);
+	freeQ = readyQ = NULL;
+	for(int i = 0; i < SLIDE_COUNT; i ++)
+		canvas_free(&slides[i].canvas);
+	return ESP_ERR_NO_MEM;
+}
+
+Slide_t *slideshow_next(void)
+{
+	Slide_t *slide;
+	xQueueReceive(readyQ, &slide, portMAX_DELAY);
+	return slide;
+}
+
+void slideshow_release(Slide_t *slide)
+{
+	xQueueSend(freeQ, &slide, portMAX_DELAY);
+}
@@ -0,0 +1,56 @@
+#ifndef __SLIDESHOW_H
+#define __SLIDESHOW_H
+
+#include "esp_err.h"
+#include "imgDecoder.h"
+
+/*
+ * Prefetching slideshow.
+ *
+ * A producer task, pinned to the other core, walks a directory in readdir()
+ * order, from an index kept up to date with index_sync(), and decodes each
+ * image onto a display sized canvas (in PSRAM when there is some) while the
+ * previous one is on screen. The display task takes finished slides with
+ * slideshow_next() and puts their canvas on screen with transition_run(), so
+ * images change at once (or fade in) instead of being drawn as they are
+ * decoded.
+ *
+ * Animated GIFs can't be kept as one frame. They are handed over with live
+ * set and only the path filled in, for the display task to decode itself.
+ */
+
+#define SLIDE_COUNT       3       // on screen (kept for the next transition) and decoded ahead
+#define SLIDE_PATH_MAX    128
+
+typedef struct {
+	ImgCanvas_t canvas;             // the whole screen, image on the background
+	char path[SLIDE_PATH_MAX];      // empty at the end of a pass over the directory
+	const char *name;               // file name part of path
+	bool live;                      // decode to the display instead, see above
+	esp_err_t ret;                  // decode result
+} Slide_t;
+
+/**
+ * @brief The producer's decoder, it draws into the slide being prefetched.
+ *        Set it up (center, cache...) before slideshow_start().
+ */
+imgDecoder *slideshow_decoder(LcdSize_t size);
+
+// Free the producer's decoder and its arena, when the slideshow isn't running.
+void slideshow_decoder_free(void);
+
+/**
+ * @brief Allocate the slides and start the producer.
+ * @param index index file of dir, see imgIndex.h
+ * @param background screen color around the images, as from CMyLcd::color565()
+ * @param core CPU the producer is pinned to
+ */
+esp_err_t slideshow_start(const char *dir, const char *index, uint16_t background, int core);
+
+// Wait for the next slide. It is the caller's until slideshow_release().
+Slide_t *slideshow_next(void);
+
+// Give a slide back to the producer.
+void slideshow_release(Slide_t *slide);
+
+#endif /* __SLIDESHOW_H */
@@ -0,0 +1,94 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "colorConv.h"
+#include "transition.h"
+
+static const char *TAG = "Transition";
+
+#define BLOCK_PIXELS      (PICDEC_READ_BLOCK / sizeof(uint16_t))
+
+static ImgArena_t lineArena;            // two DMA blocks, reserved on first use
+static uint16_t *lines[2];
+
+// Rows [y0, y1) in one window: a copy of to, or to blended over from with alpha.
+static esp_err_t send_rows(const ImgCanvas_t *from, const ImgCanvas_t *to, uint16_t y0, uint16_t y1,
+		int alpha, const ImgSink_t *sink)
+{
+	int idx = 0;
+	ImgArea_t area = {0, (uint16_t)(to->width - 1), y0, (uint16_t)(y1 - 1), false};
+
+	if(y0 >= y1) return ESP_OK;
+	if(sink->DrawPrepare(&area) != ESP_OK) return ESP_FAIL;
+	uint32_t pos = (uint32_t)y0 * to->width, end = (uint32_t)y1 * to->width;
+	while(pos < end) {
+		uint32_t n = end - pos;
+		if(n > BLOCK_PIXELS) n = BLOCK_PIXELS;
+		if(alpha < 0)
+			memcpy(lines[idx], to->pixels + pos, n * sizeof(uint16_t));
+		else
+			rgb565be_blend(lines[idx], to->pixels + pos, from->pixels + pos, n, alpha);
+		if(sink->FillAsync == NULL) {
+			sink->FillScreen(lines[idx], n, false);
+		} else {
+			// The other block is still being sent while this one was made.
+			sink->FillWait();
+			sink->FillAsync(lines[idx], n, false);
+			idx ^= 1;
+		}
+		pos += n;
+	}
+	if(sink->FillAsync != NULL)
+		sink->FillWait();
+	return ESP_OK;
+}
+
+esp_err_t transition_run(const ImgCanvas_t *from, const ImgCanvas_t *to, Transition_t type,
+		uint32_t ms, uint32_t fps, const ImgSink_t *sink, float *reached)
+{
+	esp_err_t ret = ESP_OK;
+
+	if(lineArena.base == NULL && arena_reserve(&lineArena, 2 * PICDEC_READ_BLOCK) != ESP_OK)
+		return ESP_ERR_NO_MEM;
+	arena_reset(&lineArena);
+	if(from == NULL || from->width != to->width || from->height != to->height)
+		type = TRANSITION_CUT;
+	if(reached != NULL) *reached = 0;
+	if(type == TRANSITION_CUT || fps == 0)
+		return canvas_draw(to, sink, &lineArena);
+	lines[0] = (uint16_t *)arena_alloc(&lineArena, PICDEC_READ_BLOCK, MALLOC_CAP_DMA);
+	lines[1] = (uint16_t *)arena_alloc(&lineArena, PICDEC_READ_BLOCK, MALLOC_CAP_DMA);
+
+	uint32_t frames = ms * fps / 1000;
+	if(frames == 0) frames = 1;
+	TickType_t period = 1000 / fps / portTICK_PERIOD_MS;
+	if(period == 0) period = 1;
+
+	int64_t t0 = esp_timer_get_time(), last = t0;
+	TickType_t wake = xTaskGetTickCount();
+	uint16_t shown = 0;         // wipe: rows of to already on screen
+	for(uint32_t f = 1; f <= frames && ret == ESP_OK; f ++) {
+		last = esp_timer_get_time();
+		if(type == TRANSITION_FADE) {
+			ret = send_rows(from, to, 0, to->height, f * RGB565_ALPHA_MAX / frames, sink);
+		} else {
+			uint16_t rows = (uint32_t)to->height * f / frames;
+			ret = send_rows(from, to, shown, rows, -1, sink);
+			shown = rows;
+		}
+		if(f < frames)
+			vTaskDelayUntil(&wake, period);
+	}
+	// Rate from frame starts, the last frame has no period after it.
+	int64_t us = esp_timer_get_time() - t0;
+	float rate = (frames > 1) ? (frames - 1) * 1000000.0f / (last - t0) : 1000000.0f / us;
+	ESP_LOGI(TAG, "%s: %d frames in %d ms, %.1f fps (aimed at %d)", (type == TRANSITION_FADE) ? "fade" : "wipe",
+			(int)frames, (int)(us / 1000), rate, (int)fps);
+	if(reached != NULL) *reached = rate;
+	return ret;
+}
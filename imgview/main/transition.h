@@ -0,0 +1,32 @@
+#ifndef __TRANSITION_H
+#define __TRANSITION_H
+
+#include "esp_err.h"
+#include "imgCanvas.h"
+
+/*
+ * Slide transitions between two display sized canvases.
+ *
+ * Frames are paced at a fixed rate with vTaskDelayUntil(). A crossfade
+ * blends both canvases line by line with rgb565be_blend() and sends the
+ * whole screen every frame; a wipe only sends the rows of the new image that
+ * each frame uncovers. If the display can't keep up the frames simply come
+ * late, the rate actually reached is logged and returned.
+ */
+
+typedef enum {
+	TRANSITION_CUT = 0,     // just send the new image
+	TRANSITION_FADE,
+	TRANSITION_WIPE,        // top to bottom
+} Transition_t;
+
+/**
+ * @brief Change the screen from one canvas to the other.
+ * @param from what is on screen now
+ * @param ms duration, fps frames per second to aim for
+ * @param reached frames per second reached, may be NULL
+ */
+esp_err_t transition_run(const ImgCanvas_t *from, const ImgCanvas_t *to, Transition_t type,
+		uint32_t ms, uint32_t fps, const ImgSink_t *sink, float *reached);
+
+#endif /* __TRANSITION_H */
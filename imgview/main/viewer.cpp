@@ -10,6 +10,8 @@
 #include "lcd.h"
 #include "sdcard.h"
 #include "imgDecoder.h"
+#include "slideshow.h"
+#include "transition.h"
 
 CMyLcd *lcd = NULL;
 SDCard *card = NULL;
@@ -21,6 +23,13 @@ static const char *TAG = "Viewer";
 #define BMP_PATH         "/bmp"
 #define JPG_PATH         "/jpg"
 #define IMG_PATH         "/img"
+#define CACHE_PATH       "/cache"
+#define INDEX_FILE       "/img.idx"    // index of IMG_PATH, kept in CACHE_PATH
+#define PACK_PARTITION   "imgpack"
+#define DECODER_ARENA    (28 * 1024)   // GIF needs ~26KB, JPEG ~9KB, BMP less
+#define SLIDESHOW_CORE   1             // app_main runs on the other one
+#define TRANSITION_MS    500
+#define TRANSITION_FPS   25
 
 /*
 
@@ -165,10 +174,9 @@ int lcd_log_vprintf(const char *fmt, va_list ap)
 
 esp_err_t setDrawAddr(ImgArea_t *pRect)
 {
-	lcd->setRotation(2);
 	if((pRect->right + 1) > lcd->width()) return ESP_FAIL;
 	if((pRect->bottom + 1) > lcd->height()) return ESP_FAIL;
-	lcd->setAddrWindow(pRect->left, pRect->top, pRect->right, pRect->bottom);
+	lcd->setAddrWindow(pRect->left, pRect->top, pRect->right, pRect->bottom, pRect->bottomUp);
 	return ESP_OK;
 }
 
@@ -177,6 +185,23 @@ void fillData(const uint16_t *data, uint16_t size, bool swap)
 	lcd->fillDataFast(data, size, swap);
 }
 
+void fillDataAsync(const uint16_t *data, uint16_t size, bool swap)
+{
+	lcd->fillDataAsync(data, size, swap);
+}
+
+void fillWait(void)
+{
+	lcd->fillWait();
+}
+
+void frameDelay(uint32_t ms)
+{
+	vTaskDelay(ms / portTICK_RATE_MS);
+}
+
+const ImgSink_t lcdSink = {setDrawAddr, fillData, fillDataAsync, fillWait, frameDelay};
+
 char *fullname = NULL;
 char *getname(const char *a, const char *b)
 {
@@ -191,6 +216,27 @@ char *getname(const char *a, const char *b)
 	return fullname;
 }
 
+void showCaption(const char *name, esp_err_t ret)
+{
+	lcd->setTextColor(COLOR_WHITE);
+	lcd->drawString(name, 0, 0);
+	if(ret != ESP_OK) {
+		lcd->setTextColor(COLOR_RED);
+		lcd->drawString("Image decode failed!", 4, 76);
+	}
+	vTaskDelay(2000 / portTICK_RATE_MS);
+}
+
+// Images from the flash pack need neither the sdcard nor any decoding.
+void showPacked(void)
+{
+	const char *name;
+	for(uint16_t i = 0; (name = decoder->packName(i)) != NULL; i ++) {
+		lcd->fillScreen(lcd->color565(0x80, 0x80, 0x80));
+		showCaption(name, decoder->decodePacked(name));
+	}
+}
+
 extern "C" void app_main()
 {
   LcdSize_t lcd_size = {128, 160};
@@ -227,10 +273,6 @@ extern "C" void app_main()
 	  lcd = new CMyLcd(&lcd_pins);
   }
 
-  if(card == NULL) {
-	  card = new SDCard(&sd_conf);
-  }
-
   /*screen initialize*/
   lcd->setRotation(3);             //Landscape mode
   lcd->fillScreen(lcd->color565(0x80, 0x80, 0x80));
@@ -246,30 +288,79 @@ extern "C" void app_main()
 
   if(decoder == NULL) {
     decoder = new imgDecoder(setDrawAddr, fillData, lcd_size);
+    decoder->setAsyncFill(fillDataAsync, fillWait);
+    decoder->setCenter(true);
+    decoder->setThumbnail(true);
+    decoder->setFrameDelay(frameDelay);
+    decoder->reserve(DECODER_ARENA);
+    decoder->setPack(PACK_PARTITION);
   }
+  imgDecoder *prefetch = slideshow_decoder(lcd_size);
+  prefetch->setCenter(true);
+  prefetch->setThumbnail(true);
+  prefetch->reserve(DECODER_ARENA);
   ESP_LOGI(TAG, "file type: %s", decoder->imgType2String(decoder->checkType("HelloWorld.jpg")));
   ESP_LOGI(TAG, "file type: %s", decoder->imgType2String(decoder->checkType("HelloWorld.gif")));
   ESP_LOGI(TAG, "file type: %s", decoder->imgType2String(decoder->checkType("HelloWorld.bmp")));
   ESP_LOGI(TAG, "file type: %s", decoder->imgType2String(decoder->checkType("HelloWorld.GIF")));
   ESP_LOGI(TAG, "file type: %s", decoder->imgType2String(decoder->checkType("HelloWorld.TXT")));
+  lcd->setRotation(2);             //Portrait, images and captions
+  showPacked();
+
+  if(card == NULL) {
+	  card = new SDCard(&sd_conf);
+	  prefetch->setCache(SDCARD_PATH CACHE_PATH);
+  }
+  if(slideshow_start(SDCARD_PATH IMG_PATH, SDCARD_PATH CACHE_PATH INDEX_FILE, lcd->color565(0x80, 0x80, 0x80), SLIDESHOW_CORE) == ESP_OK) {
+	  char name[SLIDE_PATH_MAX];
+	  Slide_t *shown = NULL;        // slide on screen, kept to transition from
+	  unsigned count = 0;
+	  while(1) {
+		  // The next image was decoded while the last one was on screen.
+		  Slide_t *slide = slideshow_next();
+		  if((slide->path[0] == 0 || slide->live) && shown != NULL) {
+			  // Packed images and GIFs are drawn straight to the screen.
+			  slideshow_release(shown);
+			  shown = NULL;
+		  }
+		  if(slide->path[0] == 0) {
+			  slideshow_release(slide);
+			  vTaskDelay(2000 / portTICK_RATE_MS);
+			  showPacked();
+			  continue;
+		  }
+		  snprintf(name, sizeof(name), "%s", slide->name);
+		  if(slide->live) {
+			  lcd->fillScreen(lcd->color565(0x80, 0x80, 0x80));
+			  ret = decoder->decode(slide->path);
+			  slideshow_release(slide);
+		  } else {
+			  // Crossfade and wipe in turn, a cut when there is nothing to fade from.
+			  Transition_t type = (count ++ & 1) ? TRANSITION_WIPE : TRANSITION_FADE;
+			  ret = transition_run((shown != NULL) ? &shown->canvas : NULL, &slide->canvas, type,
+					  TRANSITION_MS, TRANSITION_FPS, &lcdSink, NULL);
+			  if(ret == ESP_OK) ret = slide->ret;
+			  if(shown != NULL) slideshow_release(shown);
+			  shown = slide;
+		  }
+		  showCaption(name, ret);
+	  }
+  }
+  // No slideshow, give back the prefetch decoder's arena.
+  slideshow_decoder_free();
+  decoder->setCache(SDCARD_PATH CACHE_PATH);
   while(1) {
   	  dir = opendir(SDCARD_PATH IMG_PATH);
   	  while((dc = readdir(dir)) != NULL) {
   		  if(dc->d_type == 1) {
   			  lcd->fillScreen(lcd->color565(0x80, 0x80, 0x80));
   			  ret = decoder->decode((const char *)getname(SDCARD_PATH IMG_PATH "/", dc->d_name));
-  			  lcd->setRotation(2);
-  			  lcd->setTextColor(COLOR_WHITE);
-  			  lcd->drawString(dc->d_name, 0, 0);
-  			  if(ret != ESP_OK) {
-  				  lcd->setTextColor(COLOR_RED);
-  				  lcd->drawString("Image decode failed!", 4, 76);
-  			  }
-  			  vTaskDelay(2000 / portTICK_RATE_MS);
+  			  showCaption(dc->d_name, ret);
   		  }
   	  }
   	  closedir(dir);
   	  vTaskDelay(2000 / portTICK_RATE_MS);
+  	  showPacked();
     }
 //  while(1) {
 //  	  dir = opendir(SDCARD_PATH JPG_PATH);
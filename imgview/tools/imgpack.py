@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+#
+# Build an image pack for the imgpack flash partition (format in
+# components/middlewares/picDec/imgPack.h).
+#
+# Every image Pillow can read (BMP, JPEG, PNG, GIF first frame...) is
+# scaled down to fit the display if needed, keeping its aspect ratio, and
+# stored as big-endian RGB565 so the device only copies it to the LCD.
+#
+#     python tools/imgpack.py -s 128x160 -o build/imgpack.bin /path/to/images
+#     esptool.py --chip esp32 write_flash <imgpack offset> build/imgpack.bin
+#
+# Needs Pillow (pip install Pillow).
+
+from __future__ import print_function
+
+import argparse
+import os
+import struct
+import sys
+
+from PIL import Image
+
+IMGPACK_MAGIC = 0x4B415049      # "IPAK"
+IMGPACK_VERSION = 1
+IMGPACK_NAME_MAX = 24
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<%dsHHI' % IMGPACK_NAME_MAX)
+IMAGE_EXTS = ('.bmp', '.jpg', '.jpeg', '.png', '.gif')
+
+
+def rgb565be(img):
+    # Same truncation as RGB565BE() in colorConv.h.
+    rgb = bytearray(img.tobytes())
+    out = bytearray(len(rgb) // 3 * 2)
+    for i in range(0, len(out), 2):
+        r, g, b = rgb[i // 2 * 3:i // 2 * 3 + 3]
+        out[i] = (r & 0xF8) | (g >> 5)
+        out[i + 1] = ((g & 0x1C) << 3) | (b >> 3)
+    return bytes(out)
+
+
+def load(path, width, height):
+    img = Image.open(path)
+    img.seek(0)
+    img = img.convert('RGB')
+    if img.width > width or img.height > height:
+        img.thumbnail((width, height), Image.LANCZOS)
+    return img
+
+
+def collect(paths):
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            for name in sorted(os.listdir(path)):
+                if name.lower().endswith(IMAGE_EXTS):
+                    files.append(os.path.join(path, name))
+        else:
+            files.append(path)
+    return files
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build an imgview image pack.')
+    parser.add_argument('-s', '--size', default='128x160', help='display size, WxH (default 128x160)')
+    parser.add_argument('-o', '--output', default='imgpack.bin', help='pack file to write')
+    parser.add_argument('-p', '--partition-size', type=lambda v: int(v, 0), default=0,
+                        help='fail if the pack does not fit a partition of this many bytes')
+    parser.add_argument('images', nargs='+', help='image files or directories')
+    args = parser.parse_args()
+
+    width, height = (int(v) for v in args.size.lower().split('x'))
+    files = collect(args.images)
+    if not files:
+        sys.exit('no images')
+    if len(files) > 0xFFFF:
+        sys.exit('too many images')
+
+    entries = []
+    blobs = []
+    offset = HEADER.size + ENTRY.size * len(files)
+    for path in files:
+        name = os.path.basename(path).encode('utf-8')
+        if len(name) >= IMGPACK_NAME_MAX:
+            sys.exit('%s: name longer than %d bytes' % (path, IMGPACK_NAME_MAX - 1))
+        if name in (e[0] for e in entries):
+            sys.exit('%s: duplicate name' % path)
+        img = load(path, width, height)
+        offset = (offset + 3) & ~3
+        entries.append((name, img.width, img.height, offset))
+        blobs.append((offset, rgb565be(img)))
+        offset += img.width * img.height * 2
+        print('%-24s %4dx%-4d @ 0x%06x' % (name.decode('utf-8'), img.width, img.height, entries[-1][3]))
+
+    size = offset
+    if args.partition_size and size > args.partition_size:
+        sys.exit('pack is %d bytes, partition only %d' % (size, args.partition_size))
+
+    data = bytearray(size)
+    data[0:HEADER.size] = HEADER.pack(IMGPACK_MAGIC, IMGPACK_VERSION, len(entries), size, 0)
+    for i, entry in enumerate(entries):
+        pos = HEADER.size + i * ENTRY.size
+        data[pos:pos + ENTRY.size] = ENTRY.pack(*entry)
+    for pos, blob in blobs:
+        data[pos:pos + len(blob)] = blob
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print('%d images, %d bytes -> %s' % (len(entries), size, args.output))
+
+
+if __name__ == '__main__':
+    main()